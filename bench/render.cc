@@ -0,0 +1,179 @@
+// Cost of a frame: each view renders fixed fixtures into a headless
+// 120 x 40 Screen writing to /dev/null, either paging down (every row
+// changes) or moving the cursor a row (a few do).  The keywords fixture
+// marks that many keywords, 300 unless given on the command line: the
+// words of the text and more that share their prefixes.
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "keywords.h"
+#include "screen.h"
+#include "buf.h"
+#include "view.h"
+#include "table_view.h"
+#include "para_view.h"
+
+extern "C" int tc_init();
+
+using namespace e;
+
+namespace {
+
+const int frames = 200;
+
+const char *words[] = {
+   "alpha", "beta", "gamma", "delta", "line", "text", "of", "the", "and",
+   "zebra", "quick", "brown", "fox", "jumps", "over", "lazy", "dog",
+};
+const char *latin1[] = { "é", "ü", "ñ", "ç", "ø", "à" };
+const char *cjk[]    = { "漢", "字", "東", "京", "日", "本" };
+
+std::string
+word(int r)
+{
+   return words[r % (sizeof words / sizeof *words)];
+}
+
+// keyword i: the words themselves first, then longer ones after them
+std::string
+keyword(int i)
+{
+   const int n = sizeof words / sizeof *words;
+   return i < n ? word(i) : word(i) + std::to_string(i / n);
+}
+
+void
+toggle_keywords(int n)
+{
+   for (int i = 0; i < n; i++) {
+      const std::string w = keyword(i);
+      keywords.toggle(w.data(), w.size()); }
+}
+
+// lines of about size bytes; kind is plain, utf8 or dsv (50 fields)
+std::string
+make_text(const char *kind, int lines, int size)
+{
+   std::string t, kinds = kind;
+   srand(1);
+   for (int i = 0; i < lines; i++) {
+      std::string l;
+      for (int f = 0; kinds == "dsv" ? f < 50 : (int)l.size() < size; f++) {
+         const int r = rand();
+         if (kinds == "dsv") {
+            if (f) l += ':';
+            l += word(r) + std::to_string(r % 1000); }
+         else if (kinds == "utf8") {
+            l += r % 3 == 0 ? cjk[r / 3 % 6] : r % 3 == 1 ? latin1[r / 3 % 6] :
+                 word(r / 3).c_str();
+            l += ' '; }
+         else
+            l += word(r) + ' '; }
+      t += l + '\n'; }
+   return t;
+}
+
+struct Fixture {
+   const char *name;
+   std::string text;
+   int  lines;
+   bool keywords;
+};
+
+struct Result { double ns, bytes, escapes, writes; };
+
+Result
+run(View &v, void (*step)(View &, int, int), int lines)
+{
+   using clock = std::chrono::steady_clock;
+   const ScreenStats s0 = screen.stats();
+
+   auto t0 = clock::now();
+   for (int i = 0; i < frames; i++) {
+      step(v, i, lines);
+      screen.begin();
+      v.show();
+      screen.end(); }
+   auto t1 = clock::now();
+
+   const ScreenStats &s1 = screen.stats();
+   return Result {
+      std::chrono::duration<double, std::nano>(t1 - t0).count() / frames,
+      double(s1.bytes - s0.bytes) / frames,
+      double(s1.escapes - s0.escapes) / frames,
+      double(s1.writes - s0.writes) / frames };
+}
+
+View *
+make_view(const char *kind, Buf *b)
+{
+   std::string k = kind;
+   return k == "table" ? new TableView(b) :
+          k == "para"  ? new ParaView(b) : new View(b);
+}
+
+}
+
+int
+main(int argc, char **argv)
+{
+   const int n_keywords = argc > 1 ? atoi(argv[1]) : 300;
+
+   setenv("TERM", "xterm-256color", 0);
+   tc_init();
+   screen.set_size(120, 40);
+   screen.set_output(open("/dev/null", O_WRONLY));
+
+   std::vector<Fixture> fixtures {
+      { "plain",    make_text("plain", 20000, 70),  20000, false },
+      { "long",     make_text("plain", 500, 8000),  500,   false },
+      { "utf8",     make_text("utf8", 20000, 70),   20000, false },
+      { "dsv50",    make_text("dsv", 20000, 0),     20000, false },
+      { "keywords", make_text("plain", 20000, 70),  20000, true },
+   };
+   const char *views[] = { "text", "table", "para" };
+
+   printf("(keywords fixture: %d keywords)\n", n_keywords);
+   printf("%-9s %-6s %-7s %10s %10s %9s %7s\n", "fixture", "view", "frames",
+          "ns/frame", "bytes", "escapes", "writes");
+   for (auto &f : fixtures) {
+      char name[] = "/tmp/bench_render.XXXXXX";
+      int fd = mkstemp(name);
+      if (fd == -1) { perror("mkstemp"); return 1; }
+      if (write(fd, f.text.data(), f.text.size()) != (ssize_t)f.text.size())
+         return 1;
+      close(fd);
+
+      Buf b(name);
+      b.wait_loaded();
+      if (f.keywords) toggle_keywords(n_keywords);
+      b.hits().rebuild();
+      b.hits().wait();
+
+      for (auto kind : views) {
+         struct { const char *name; void (*step)(View &, int, int); } modes[] = {
+            { "page",   [](View &v, int i, int n) {
+                 const int h = v.get_window_height();
+                 v.window_move((i + 1) * h % (n - h)); } },
+            { "cursor", [](View &v, int i, int) {
+                 v.cursor_move_row_abs(i % v.get_window_height()); } },
+         };
+         for (auto &m : modes) {
+            View *v = make_view(kind, &b);
+            b.columns().wait();
+            screen.clear();
+            Result r = run(*v, m.step, f.lines);
+            printf("%-9s %-6s %-7s %10.0f %10.0f %9.0f %7.2f\n",
+                   f.name, kind, m.name, r.ns, r.bytes, r.escapes, r.writes);
+            delete v; } }
+
+      if (f.keywords) toggle_keywords(n_keywords);
+      unlink(name); }
+   printf("(per frame, %dx%d headless screen)\n", 120, 40);
+}
@@ -0,0 +1,314 @@
+// Cost of the Str and Buf primitives the views lean on: Str::len(),
+// operator[], index_chars_to_bytes(), search_word() and match_word() on
+// ASCII, Latin-1-heavy and CJK-heavy lines of several lengths, each field
+// splitting kernel on DSV and quoted CSV rows, and Buf load (to the first
+// window and in full), save, show, insert_empty_line and delete_line on
+// files of 10k and 1M lines, and 10M given a line count that high.
+// Inputs come from a fixed seed and each figure is the median of a fixed
+// number of runs, so two commits can be compared row by row.  Writes CSV,
+// or JSON with -j; a line count caps the Buf sizes (default 1M).
+
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "utf8.h"
+#include "fields.h"
+#include "str.h"
+#include "keywords.h"
+#include "buf.h"
+
+using namespace e;
+
+namespace {
+
+const int runs = 5;
+
+const char *words[] = {
+   "alpha", "beta", "gamma", "delta", "line", "text", "of", "the", "and",
+   "zebra", "quick", "brown", "fox", "jumps", "over", "lazy", "dog",
+};
+const int nwords = sizeof words / sizeof *words;
+const char *latin1[] = { "é", "ü", "ñ", "ç", "ø", "à" };
+const char *cjk[]    = { "漢", "字", "東", "京", "日", "本" };
+
+// words (the first eight are the keywords) with script's chars mixed in
+void
+append_words(std::string &s, const char *script, size_t size, std::mt19937 &g)
+{
+   while (s.size() < size) {
+      const unsigned r = g();
+      if (script[0] == 'l' && r % 5 < 2)
+         s += latin1[r / 5 % 6];
+      else if (script[0] == 'c' && r % 10 < 7)
+         s += cjk[r / 10 % 6];
+      else
+         s += words[r / 10 % nwords];
+      s += ' '; }
+}
+
+std::string
+make_line(const char *script, size_t size)
+{
+   std::mt19937 g(1);
+   std::string s;
+   append_words(s, script, size, g);
+   // cut on a char boundary
+   size_t n = std::min(size, s.size());
+   while (n && (s[n] & 0xc0) == 0x80) n--;
+   s.resize(n);
+   return s;
+}
+
+// about 60 bytes a line, one in eight of them non-ASCII
+std::string
+make_file(int lines)
+{
+   std::mt19937 g(1);
+   std::string t;
+   t.reserve(lines * 64L);
+   for (int i = 0; i < lines; i++) {
+      append_words(t, i % 8 ? "ascii" : i % 16 ? "latin1" : "cjk",
+                   t.size() + 60, g);
+      t += '\n'; }
+   return t;
+}
+
+struct Row {
+   const char *suite, *op, *text;
+   long bytes, lines, ops;
+   double median, min; // ns per op
+};
+
+std::vector<Row> rows;
+volatile long sink;
+
+double
+now()
+{
+   using namespace std::chrono;
+   return duration<double, std::nano>(steady_clock::now().time_since_epoch()).count();
+}
+
+// f() does ops operations; setup() is run untimed before each run
+template <class S, class F> void
+measure_op(Row r, S setup, F f)
+{
+   std::vector<double> t;
+   for (int i = 0; i < runs; i++) {
+      setup();
+      const double t0 = now();
+      f();
+      t.push_back((now() - t0) / r.ops); }
+   std::sort(t.begin(), t.end());
+   r.median = t[runs / 2];
+   r.min    = t[0];
+   rows.push_back(r);
+}
+
+template <class F> void
+measure_op(Row r, F f)
+{
+   f(); // warm up
+   measure_op(r, []{}, f);
+}
+
+void
+bench_str(Keywords &kw)
+{
+   const char *scripts[] = { "ascii", "latin1", "cjk" };
+   const int sizes[]     = { 16, 80, 1024, 65536 };
+
+   for (auto script : scripts)
+      for (int size : sizes) {
+         const std::string line = make_line(script, size);
+         Span l { line.data(), (int)line.size() };
+         measure(l);
+         l.marks = l.size >= Str::mark_min ? mark(l) : nullptr; // as Buf
+         const long bytes = l.size;
+
+         std::mt19937 g(2);
+         std::vector<int> at(4096);
+         for (auto &i : at) i = g() % l.len;
+
+         const long reps = std::max(1L, (16L << 20) / bytes);
+         measure_op(Row { "str", "len", script, bytes, 1, reps }, [&] {
+            long sum = 0;
+            for (long i = 0; i < reps; i++)
+               sum += Str(Span { l.s, l.size }).len();
+            sink = sum; });
+
+         const long lookups = 1 << 18;
+         measure_op(Row { "str", "operator[]", script, bytes, 1, lookups }, [&] {
+            Str s(l);
+            long sum = 0;
+            for (long i = 0; i < lookups; i++)
+               sum += s[at[i % at.size()]];
+            sink = sum; });
+
+         measure_op(Row { "str", "index_chars_to_bytes", script, bytes, 1, lookups }, [&] {
+            Str s(l);
+            long sum = 0;
+            for (long i = 0; i < lookups; i++)
+               sum += s.index_chars_to_bytes(at[i % at.size()]);
+            sink = sum; });
+
+         // every keyword in the line, one call each
+         Str s(l);
+         long calls = 0;
+         for (int p = 0; (p = s.search_word(kw, p)) >= 0; p++) calls++;
+         calls++; // the one that finds none
+         const long scans = std::max(1L, (4L << 20) / bytes);
+         measure_op(Row { "str", "search_word", script, bytes, 1, scans * calls }, [&] {
+            Str s(l);
+            long sum = 0;
+            for (long i = 0; i < scans; i++)
+               for (int p = 0; (p = s.search_word(kw, p)) >= 0; p++) sum += p;
+            sink = sum; });
+
+         measure_op(Row { "str", "match_word", script, bytes, 1, lookups }, [&] {
+            Str s(l);
+            long sum = 0;
+            for (long i = 0; i < lookups; i++)
+               sum += s.match_word(kw, at[i % at.size()]) != nullptr;
+            sink = sum; });
+
+         delete[] l.marks; }
+}
+
+// a word a field; in csv every third is quoted, with a comma in it
+std::string
+make_row(const char *dialect, size_t size)
+{
+   std::mt19937 g(4);
+   const bool csv = dialect[0] == 'c';
+   std::string s;
+   for (int k = 0; s.size() < size; k++) {
+      if (k) s += csv ? ',' : ':';
+      const std::string w = words[g() % nwords];
+      s += csv && k % 3 == 2 ? "\"" + w + ", " + cjk[k % 6] + "\"" : w; }
+   return s;
+}
+
+void
+bench_fields()
+{
+   const char *dialects[] = { "dsv", "csv" };
+   const int sizes[]      = { 80, 1024, 65536 };
+
+   for (auto dialect : dialects)
+      for (int size : sizes) {
+         const std::string row = make_row(dialect, size);
+         Span l { row.data(), (int)row.size() };
+         measure(l);
+         Dsv d;
+         Dsv::parse(dialect[0] == 'c' ? "csv" : ":", d);
+         const long reps = std::max(1L, (16L << 20) / l.size);
+         for (auto k = fields_kernels; k->name; k++)
+            measure_op(Row { "fields", k->name, dialect, l.size, 1, reps }, [&] {
+               Fields f;
+               long sum = 0;
+               for (long i = 0; i < reps; i++) {
+                  k->split(l, d, f);
+                  sum += f.count(); }
+               sink = sum; }); }
+}
+
+void
+bench_buf(int max_lines)
+{
+   const int sizes[] = { 10000, 1000000, 10000000 };
+   const char *tmp = getenv("TMPDIR");
+   const std::string name = std::string(tmp ? tmp : "/tmp") + "/bench_str_buf.txt";
+
+   for (int n : sizes) {
+      if (n > max_lines) break;
+      const std::string text = make_file(n);
+      const long bytes = text.size();
+      FILE *f = fopen(name.c_str(), "w");
+      if (!f || fwrite(text.data(), 1, bytes, f) != (size_t)bytes ||
+          fclose(f) == EOF) {
+         perror(name.c_str());
+         exit(1); }
+
+      Buf *b = nullptr;
+      measure_op(Row { "buf", "load_window", "mixed", bytes, n, 1 },
+                 [&] { delete b; b = nullptr; },
+                 [&] { b = new Buf(name.c_str()); b->wait_lines(40); });
+      measure_op(Row { "buf", "load", "mixed", bytes, n, 1 },
+                 [&] { delete b; b = nullptr; },
+                 [&] { b = new Buf(name.c_str()); b->wait_loaded(); });
+
+      std::mt19937 g(3);
+      std::vector<int> at(10000);
+      for (auto &i : at) i = g() % n;
+
+      const int window = 40, shows = 2000;
+      measure_op(Row { "buf", "show", "mixed", bytes, n, shows }, [&] {
+         std::vector<Span> v;
+         long sum = 0;
+         for (int i = 0; i < shows; i++) {
+            v.clear();
+            b->show(v, at[i], at[i] + window);
+            for (auto &l : v) sum += l.len; }
+         sink = sum; });
+
+      // delete_line undoes the inserts, so each run starts from n lines
+      bool inserted = false;
+      auto insert = [&] { for (int i : at) b->insert_empty_line(i); };
+      auto undo   = [&] { for (auto i = at.rbegin(); i != at.rend(); ++i) b->delete_line(*i); };
+      measure_op(Row { "buf", "insert_empty_line", "mixed", bytes, n, (long)at.size() },
+                 [&] { if (inserted) undo(); },
+                 [&] { insert(); inserted = true; });
+      measure_op(Row { "buf", "delete_line", "mixed", bytes, n, (long)at.size() },
+                 [&] { if (!inserted) insert(); },
+                 [&] { undo(); inserted = false; });
+
+      measure_op(Row { "buf", "save", "mixed", bytes, n, 1 }, [] {},
+                 [&] { b->save(); });
+      delete b;
+      unlink(name.c_str()); }
+}
+
+}
+
+int
+main(int argc, char **argv)
+{
+   bool json = false;
+   int max_lines = 1000000;   // 10M lines is some 600 MB: on request
+   for (int i = 1; i < argc; i++)
+      if (!strcmp(argv[i], "-j")) json = true;
+      else max_lines = atoi(argv[i]);
+
+   Keywords kw;
+   for (int i = 0; i < 8; i++)
+      kw.toggle(words[i], strlen(words[i]));
+
+   bench_str(kw);
+   bench_fields();
+   bench_buf(max_lines);
+
+   if (json) {
+      printf("{\"utf8_kernel\": \"%s\", \"runs\": %d, \"results\": [\n",
+             utf8_kernel().name, runs);
+      for (size_t i = 0; i < rows.size(); i++) {
+         const Row &r = rows[i];
+         printf("  {\"suite\": \"%s\", \"op\": \"%s\", \"text\": \"%s\", "
+                "\"bytes\": %ld, \"lines\": %ld, \"ops\": %ld, "
+                "\"median_ns\": %.1f, \"min_ns\": %.1f}%s\n",
+                r.suite, r.op, r.text, r.bytes, r.lines, r.ops,
+                r.median, r.min, i + 1 < rows.size() ? "," : ""); }
+      printf("]}\n"); }
+   else {
+      printf("suite,op,text,bytes,lines,ops,median_ns,min_ns\n");
+      for (auto &r : rows)
+         printf("%s,%s,%s,%ld,%ld,%ld,%.1f,%.1f\n", r.suite, r.op, r.text,
+                r.bytes, r.lines, r.ops, r.median, r.min); }
+}
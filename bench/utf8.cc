@@ -0,0 +1,71 @@
+// Throughput of the UTF-8 kernels behind Str::len(), index_chars_to_bytes()
+// and index_bytes_to_chars() on ASCII, Latin-1-heavy and CJK-heavy lines.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "utf8.h"
+
+using namespace e;
+
+namespace {
+
+std::string
+make_line(const char *script, size_t size)
+{
+   static const char *latin1[] = { "é", "ü", "ñ", "ç", "ø", "à" };
+   static const char *cjk[]    = { "漢", "字", "東", "京", "日", "本" };
+   std::string s;
+   srand(1);
+
+   while (s.size() < size) {
+      int r = rand();
+      if (script[0] == 'l' && r % 5 < 2)
+         s += latin1[r / 5 % 6];
+      else if (script[0] == 'c' && r % 10 < 9)
+         s += cjk[r / 10 % 6];
+      else
+         s += 'a' + r / 10 % 26; }
+   s.resize(size);
+   return s;
+}
+
+volatile long sink;
+
+template <class F> double
+gbps(const std::string &s, F f)
+{
+   using clock = std::chrono::steady_clock;
+   long reps = (256L << 20) / s.size() + 1, sum = 0;
+
+   f(s.data(), s.size()); // warm up
+   auto t0 = clock::now();
+   for (long i = 0; i < reps; i++)
+      sum += f(s.data(), s.size());
+   auto t1 = clock::now();
+   sink = sum;
+   return reps * s.size() / std::chrono::duration<double>(t1 - t0).count() / 1e9;
+}
+
+}
+
+int
+main()
+{
+   const char *scripts[] = { "ascii", "latin1", "cjk" };
+   const size_t sizes[]  = { 80, 4096, 1 << 20 };
+
+   printf("%-7s %-7s %8s %10s %10s\n", "kernel", "text", "bytes", "count", "offset");
+   for (auto script : scripts)
+      for (auto size : sizes) {
+         std::string s = make_line(script, size);
+         const int last = utf8_kernels[0].count(s.data(), s.size()) - 1;
+         for (auto k = utf8_kernels; k->name; k++) {
+            // offset() for the last char scans the whole line too
+            double c = gbps(s, [k](const char *p, int n) { return k->count(p, n); });
+            double o = gbps(s, [k, last](const char *p, int n) { return k->offset(p, n, last); });
+            printf("%-7s %-7s %8zu %10.2f %10.2f\n", k->name, script, size, c, o); } }
+   printf("(GB/s; in use: %s)\n", utf8_kernel().name);
+}
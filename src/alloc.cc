@@ -0,0 +1,181 @@
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include "alloc.h"
+
+namespace e {
+
+char *
+MallocLineAlloc::alloc(size_t size)
+{
+   stats_.allocs++;
+   stats_.sys_allocs++;
+   stats_.live_bytes += size;
+   return (char *)malloc(size);
+}
+
+void
+MallocLineAlloc::free(const char *p, size_t size)
+{
+   if (!p) return;
+   stats_.frees++;
+   stats_.sys_frees++;
+   stats_.live_bytes -= size;
+   ::free((void *)p);
+}
+
+SlabLineAlloc::~SlabLineAlloc()
+{
+   for (auto i : slabs_)
+      ::free(i);
+}
+
+int
+SlabLineAlloc::cls(size_t size)
+{
+   if (size <= 16) return 0;
+   int c = sizeof(unsigned long) * 8 - __builtin_clzl(size - 1) - 4;
+   return c < classes ? c : -1;
+}
+
+char *
+SlabLineAlloc::alloc(size_t size)
+{
+   stats_.allocs++;
+   stats_.live_bytes += size;
+
+   int c = cls(size);
+   if (c < 0) {
+      stats_.sys_allocs++;
+      return (char *)malloc(size); }
+
+   if (!free_[c]) {
+      char *slab = (char *)malloc(slab_size);
+      if (!slab) return nullptr;
+      stats_.sys_allocs++;
+      slabs_.push_back(slab);
+      const size_t n = 16 << c;
+      for (size_t i = slab_size / n; i--; ) {
+         auto f = (Free *)(slab + i * n);
+         f->next = free_[c];
+         free_[c] = f; } }
+
+   Free *f = free_[c];
+   free_[c] = f->next;
+   return (char *)f;
+}
+
+void
+SlabLineAlloc::free(const char *p, size_t size)
+{
+   if (!p) return;
+   stats_.frees++;
+   stats_.live_bytes -= size;
+
+   int c = cls(size);
+   if (c < 0) {
+      stats_.sys_frees++;
+      ::free((void *)p);
+      return; }
+
+   auto f = (Free *)p;
+   f->next = free_[c];
+   free_[c] = f;
+}
+
+namespace {
+
+SlabLineAlloc slab_alloc;
+LineAlloc *current = &slab_alloc;
+
+}
+
+LineAlloc &
+line_alloc()
+{
+   return *current;
+}
+
+// only while no lines are allocated: lines go back where they came from
+void
+set_line_alloc(LineAlloc *a)
+{
+   current = a ? a : &slab_alloc;
+}
+
+char *
+line_new(size_t len)
+{
+   char *s = current->alloc(len + 1);
+   if (s) s[len] = '\0';
+   return s;
+}
+
+char *
+line_dup(const char *s, size_t len)
+{
+   char *t = line_new(len);
+   if (t) memcpy(t, s, len);
+   return t;
+}
+
+void
+line_free(const char *s, size_t len)
+{
+   if (s) current->free(s, len + 1);
+}
+
+Arena::~Arena()
+{
+   for (auto &i : chunks_)
+      ::free(i.p);
+}
+
+char *
+Arena::chunk(size_t size)
+{
+   char *p = (char *)malloc(size);
+   if (!p) return nullptr;
+   Chunk c { p, size };
+   chunks_.insert(std::upper_bound(chunks_.begin(), chunks_.end(), c,
+         [](const Chunk &a, const Chunk &b) { return a.p < b.p; }), c);
+   bytes_ += size;
+   return p;
+}
+
+char *
+Arena::alloc(size_t size)
+{
+   if (size > chunk_size / 4)
+      return chunk(size);
+   if (size > left_) {
+      if (!(cur_ = chunk(chunk_size))) { left_ = 0; return nullptr; }
+      left_ = chunk_size; }
+   char *p = cur_;
+   cur_  += size;
+   left_ -= size;
+   return p;
+}
+
+char *
+Arena::dup(const char *s, size_t len)
+{
+   char *t = alloc(len + 1);
+   if (!t) return t;
+   memcpy(t, s, len);
+   t[len] = '\0';
+   return t;
+}
+
+bool
+Arena::owns(const char *p)
+{
+   auto i = std::upper_bound(chunks_.begin(), chunks_.end(), p,
+         [](const char *p, const Chunk &c) { return p < c.p; });
+   if (i == chunks_.begin()) return false;
+   --i;
+   return p < i->p + i->size;
+}
+
+} // namespace
@@ -0,0 +1,83 @@
+#ifndef alloc_h
+#define alloc_h
+
+#include <cstddef>
+#include <vector>
+
+namespace e {
+
+struct AllocStats {
+   long allocs, frees;          // line allocations asked for / given back
+   long sys_allocs, sys_frees;  // calls that reached malloc(3) / free(3)
+   long live_bytes;
+};
+
+// Where edited lines live.  A line of len bytes takes len + 1 (NUL) and is
+// given back with the same size, so implementations need no headers.
+class LineAlloc {
+public:
+   virtual ~LineAlloc() { }
+   virtual char *alloc(size_t size) = 0;
+   virtual void  free(const char *p, size_t size) = 0;
+   const AllocStats &stats() { return stats_; }
+protected:
+   AllocStats stats_ {};
+};
+
+class MallocLineAlloc : public LineAlloc {
+public:
+   char *alloc(size_t size);
+   void  free(const char *p, size_t size);
+};
+
+// power-of-two size classes 16..2048 carved from 64 KiB slabs and recycled
+// through per-class free lists; bigger lines go to malloc
+class SlabLineAlloc : public LineAlloc {
+public:
+   ~SlabLineAlloc();
+   char *alloc(size_t size);
+   void  free(const char *p, size_t size);
+private:
+   static const int    classes    = 8;
+   static const size_t slab_size  = 64 * 1024;
+   struct Free { Free *next; };
+
+   Free *free_[classes] {};
+   std::vector<char *> slabs_;
+
+   static int cls(size_t size);
+};
+
+LineAlloc &line_alloc();
+void set_line_alloc(LineAlloc *a);
+
+char *line_new(size_t len);                      // room for len + NUL
+char *line_dup(const char *s, size_t len);
+void  line_free(const char *s, size_t len);
+
+// Bump allocator for loaded text; everything goes at once with it.
+class Arena {
+public:
+   Arena() : cur_(nullptr), left_(0), bytes_(0) { }
+   ~Arena();
+   Arena(const Arena &) = delete;
+   Arena &operator=(const Arena &) = delete;
+   char *alloc(size_t size);
+   char *dup(const char *s, size_t len);
+   bool  owns(const char *p);
+   size_t bytes() { return bytes_; }
+private:
+   static const size_t chunk_size = 1024 * 1024;
+   struct Chunk { char *p; size_t size; };
+
+   std::vector<Chunk> chunks_;  // ascending addresses
+   char  *cur_;
+   size_t left_;
+   size_t bytes_;
+
+   char *chunk(size_t size);
+};
+
+} // namespace
+
+#endif
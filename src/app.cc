@@ -9,6 +9,11 @@
 #include <iostream>
 #include <algorithm>
 #include <sys/ioctl.h>
+#include <sys/signalfd.h>
+#include <signal.h>
+#include "alloc.h"
+#include "latency.h"
+#include "screen.h"
 #include "buf.h"
 #include "view.h"
 #include "table_view.h"
@@ -23,83 +28,174 @@ extern "C" {
 namespace e {
 
 #define ESC '\033'
+
+namespace {
+
+const int frame_ms = 16;   // at most ~60 frames a second
+
+// an on/off switch: set, and neither empty nor "0"
+bool
+env_on(const char *name)
+{
+   const char *s = getenv(name);
+   return s && *s && strcmp(s, "0");
+}
+
+}
+
 void
 App::mainloop()
 {
    Buf  &b = *buf_;
    View &v = *(type_ == 1 ? new TableView(&b) :
                type_ == 2 ? new ParaView(&b) : new View(&b));
+   view_ = &v;
 
-   char cmd = '\0', prev_cmd;
-
+   // the first window is drawn as soon as its lines are in
+   b.wait_lines(line_ + v.get_window_height());
    v.cursor_move_row_abs(line_);
    if (line_) v.window_centre_cursor();
-   tc("cl");
-   v.show();
-
-   while (prev_cmd = cmd, cmd = getchar(), cmd != EOF) {
-      if (cmd >= ' ' && prev_cmd != ESC) {
-         v.char_insert(cmd);
-         tc("ho");
-         v.show();
-         continue; }
-
-      if (prev_cmd == ESC) {
-         switch (cmd) {
-      case '#': type_ = !type_; delete &v; return;
-      case '$': type_ = type_ != 2 ? 2 : 0; delete &v; return;
-      case '<': v.window_top();     break;
-      case '>': v.window_bottom();  break;
-      case 'j': v.join(); break;
-      case 'd': v.duplicate_line(); break;
-      case 't': v.transpose_lines(); v.cursor_move_row_rel(+1); break;
-      case 'T': v.cursor_move_row_rel(-1); v.transpose_lines(); break;
-      case 'f': v.cursor_move_word_next(isalpha);  break;
-      case 'b': v.cursor_move_word_prev(isalpha);  break;
-      case 'F': v.cursor_move_word_next(isgraph);  break;
-      case 'B': v.cursor_move_word_prev(isgraph);  break;
-      case 'h': v.cursor_move_row_abs(0); break;
-      case 'l': v.cursor_move_row_end();  break;
-      case ']': v.cursor_move_para_next();  break;
-      case '[': v.cursor_move_para_prev();  break;
-      case 'v': v.page_up();   break;
-      case '+': v.set_window_height(v.get_window_height() + 1); break;
-      case '-': v.set_window_height(v.get_window_height() - 1); break;
-      case 's': b.save(); break;
-      case 'k': v.keyword_toggle(); break;
-      case 'n': v.keyword_search_next(); break;
-      case 'p': v.keyword_search_prev(); break;
-      case 'r': v.char_rotate_variant(); break;
-         }
-         tc("ho");
-         v.show();
-         tc("cd");
-         continue; }
-
-      switch (cmd + '@') {
-      case 'N': v.cursor_move_row_rel(+1);  break;
-      case 'P': v.cursor_move_row_rel(-1);  break;
-      case 'F': v.cursor_move_char_rel(+1); break;
-      case 'B': v.cursor_move_char_rel(-1); break;
-      case 'A': v.cursor_move_char_abs(0);  break;
-      case 'E': v.cursor_move_char_end();   break;
-      case 'L': v.window_centre_cursor();   break;
-      case 'I': v.indent(); break;
-      case 'O': v.exdent(); break;
-      case 'J': v.insert_new_line(); break;
-      case 'Y': v.insert_new_line(false); break;
-      case 'T': v.transpose_chars(); break;
-      case 'V': v.page_down(); break;
-      case 'X': type_ = -1; tc("cl"); return;
-      case 'D': v.char_delete_forward();  break;
-      case 'H': v.char_delete_backward(); break;
-      case 'K': v.char_delete_to_eol();   break;
-      case 'U': v.char_delete_to_bol();   break;
+   screen.clear();
+   draw();
+
+   // keys already typed are all dealt with before the next frame, unless
+   // they keep coming for longer than a frame; those left in input_ then,
+   // or after a view switch, are the loop's to come back to
+   loop_.watch(STDIN_FILENO, [this, &v]() {
+      const long t = Loop::now();
+      while (input_.pending() && Loop::now() - t < frame_ms) {
+         const int cmd = input_.get(), prev_cmd = prev_cmd_;
+         const long t0 = Latency::now();
+         if (!key(v, cmd)) {
+            loop_.quit();
+            return; }
+         // ESC on its own is the first half of a meta key
+         if (cmd != ESC || prev_cmd == ESC)
+            latency.command(prev_cmd == ESC ? cmd | Latency::meta : cmd,
+                            Latency::now() - t0); }
+      redraw(); },
+      [this]() { return input_.pending(); });
+   loop_.run();
+
+   loop_.unwatch(STDIN_FILENO);
+   loop_.cancel(frame_timer_);
+   loop_.cancel(poll_timer_);
+   frame_timer_ = poll_timer_ = -1;
+   view_ = nullptr;
+   delete &v;
+}
+
+// draws now if a frame is due, else once it is
+void
+App::redraw()
+{
+   if (frame_timer_ >= 0) return;
+   const long wait = last_frame_ + frame_ms - Loop::now();
+   if (wait <= 0) { draw(); return; }
+   frame_timer_ = loop_.after(wait, [this]() {
+         frame_timer_ = -1;
+         draw(); });
+}
+
+void
+App::draw()
+{
+   buf_->sync(frame_ms / 2);
+   view_->keyword_search_again();
+   const long b0 = screen.stats().bytes, t0 = Latency::now();
+   screen.begin();
+   view_->show();
+   const long t1 = Latency::now();
+   screen.end();
+   latency.frame(t1 - t0, Latency::now() - t1, screen.stats().bytes - b0);
+   last_frame_ = Loop::now();
+
+   // the rest of the file comes in, and the hit count, column widths and
+   // sums show up once they are counted
+   if (poll_timer_ < 0 && (buf_->loading() || !buf_->hits().ready() ||
+                           !buf_->columns().ready() || !view_->ready()))
+      poll_timer_ = loop_.after(buf_->loading() ? frame_ms : 100, [this]() {
+            poll_timer_ = -1;
+            redraw(); });
+}
+
+// false once the view is to be switched or the editor left
+bool
+App::key(View &v, int cmd)
+{
+   Buf &b = *buf_;
+   const int prev_cmd = prev_cmd_;
+   prev_cmd_ = cmd;
+
+   if (cmd == EOF) { type_ = -1; return false; }
+
+   if (cmd == Input::paste) {
+      auto &t = input_.text();
+      v.paste(t.data(), t.size());
+      return true; }
+
+   if (cmd >= ' ' && cmd < 0x80 && prev_cmd != ESC) {
+      v.char_insert(cmd);
+      return true; }
+
+   if (prev_cmd == ESC) {
+      switch (cmd) {
+   case '#': type_ = !type_; return false;
+   case '$': type_ = type_ != 2 ? 2 : 0; return false;
+   case '<': v.window_top();     break;
+   case '>': v.window_bottom();  break;
+   case 'j': v.join(); break;
+   case 'd': v.duplicate_line(); break;
+   case 't': v.transpose_lines(); v.cursor_move_row_rel(+1); break;
+   case 'T': v.cursor_move_row_rel(-1); v.transpose_lines(); break;
+   case 'f': v.cursor_move_word_next(isalpha);  break;
+   case 'b': v.cursor_move_word_prev(isalpha);  break;
+   case 'F': v.cursor_move_word_next(isgraph);  break;
+   case 'B': v.cursor_move_word_prev(isgraph);  break;
+   case 'h': v.cursor_move_row_abs(0); break;
+   case 'l': v.cursor_move_row_end();  break;
+   case ']': v.cursor_move_para_next();  break;
+   case '[': v.cursor_move_para_prev();  break;
+   case 'v': v.page_up();   break;
+   case '+': v.set_window_height(v.get_window_height() + 1); break;
+   case '-': v.set_window_height(v.get_window_height() - 1); break;
+   case 's': b.save(); break;
+   case 'k': v.keyword_toggle(); break;
+   case 'n': v.keyword_search_next(); break;
+   case 'p': v.keyword_search_prev(); break;
+   case 'r': v.char_rotate_variant(); break;
+   case 'o': v.sort_rows(false); break;
+   case 'O': v.sort_rows(true);  break;
+   case '=': v.filter_rows('='); break;
+   case '!': v.filter_rows('!'); break;
+   case '~': v.filter_rows('~'); break;
+   case 'u': v.all_rows(); break;
+   case ',': v.separator(); break;
+   case '"': v.quotes(); break;
       }
-      tc("ho");
-      v.show();
-      tc("cd");
+      return true; }
+
+   switch (cmd + '@') {
+   case 'N': v.cursor_move_row_rel(+1);  break;
+   case 'P': v.cursor_move_row_rel(-1);  break;
+   case 'F': v.cursor_move_char_rel(+1); break;
+   case 'B': v.cursor_move_char_rel(-1); break;
+   case 'A': v.cursor_move_char_abs(0);  break;
+   case 'E': v.cursor_move_char_end();   break;
+   case 'L': v.window_centre_cursor();   break;
+   case 'I': v.indent(); break;
+   case 'O': v.exdent(); break;
+   case 'J': v.insert_new_line(); break;
+   case 'Y': v.insert_new_line(false); break;
+   case 'T': v.transpose_chars(); break;
+   case 'V': v.page_down(); break;
+   case 'X': type_ = -1; tc("cl"); return false;
+   case 'D': v.char_delete_forward();  break;
+   case 'H': v.char_delete_backward(); break;
+   case 'K': v.char_delete_to_eol();   break;
+   case 'U': v.char_delete_to_bol();   break;
    }
+   return true;
 }
 
 void
@@ -121,15 +217,75 @@ App::go()
 
    tc_init();
 
+   const char *l = getenv("E_LATENCY");
+   latency.start(latency_file_ ? latency_file_ : l && *l ? l : nullptr,
+                 env_on("E_LATENCY_LIVE"));
+
+   MallocLineAlloc malloc_alloc;
+   const char *a = getenv("E_LINE_ALLOC");
+   if (a && !strcmp(a, "malloc")) set_line_alloc(&malloc_alloc);
+
    tc("ti"); // alternative screen begin
+   fputs("\033[?2004h", stdout); // bracketed paste
    buf_ = new Buf(filename_);
+   // -d, else .csv and .tsv by their name
+   Dsv d;
+   const char *ext = strrchr(filename_, '.');
+   if (dsv_given_)
+      d = dsv_;
+   else if (ext && (!strcmp(ext, ".csv") || !strcmp(ext, ".tsv")))
+      Dsv::parse(ext + 1, d);
+   buf_->dsv(d);
+   if (const char *w = getenv("E_COLUMN_WIDTH"))
+      buf_->columns().percentile(w[0] == 'p' ? atoi(w + 1) : 100);
+
+   // SIGWINCH comes in as a read on sfd; the views pick up the new size
+   sigset_t sigs;
+   sigemptyset(&sigs);
+   sigaddset(&sigs, SIGWINCH);
+   sigprocmask(SIG_BLOCK, &sigs, nullptr);
+   int sfd = signalfd(-1, &sigs, SFD_NONBLOCK | SFD_CLOEXEC);
+   if (sfd != -1)
+      loop_.watch(sfd, [this, sfd]() {
+         struct signalfd_siginfo si;
+         while (read(sfd, &si, sizeof si) == sizeof si) ;
+         if (!view_) return;
+         view_->resize();
+         screen.clear();
+         redraw(); });
 
    while (type_ >= 0)
       mainloop();
 
+   if (sfd != -1) {
+      loop_.unwatch(sfd);
+      close(sfd); }
+
    delete buf_;
+   fputs("\033[?2004l", stdout);
    tc("te"); // alternative screen end
 
+   if (env_on("E_ALLOC_STATS")) {
+      auto &st = line_alloc().stats();
+      fprintf(stderr, "lines: %ld allocs, %ld frees; "
+                      "malloc: %ld allocs, %ld frees\n",
+              st.allocs, st.frees, st.sys_allocs, st.sys_frees); }
+   set_line_alloc(nullptr);
+
+   if (env_on("E_SCREEN_STATS")) {
+      auto &st = screen.stats();
+      const long n = st.frames ? st.frames : 1;
+      fprintf(stderr, "screen: %ld frames, %ld bytes sent (%ld per frame, "
+                      "%ld escapes), %ld for full redraws (%ld per frame); "
+                      "%ld writes (%.2f per frame, at most %ld), "
+                      "%ld failed\n",
+              st.frames, st.bytes, st.bytes / n, st.escapes / n,
+              st.full_bytes, st.full_bytes / n,
+              st.writes, (double)st.writes / n, st.max_writes,
+              st.write_errors); }
+
+   latency.dump();
+
 out:
    /* canonical mode */
    if (tcsetattr(fd, TCSANOW, &ti_orig) == -1) {
@@ -137,16 +293,33 @@ out:
    if (close(fd) == -1) perror("close");
 }
 
-App::App(char **a)
+App::App(char **a) :
+   input_(STDIN_FILENO),
+   view_(nullptr),
+   prev_cmd_('\0'),
+   last_frame_(0),
+   frame_timer_(-1),
+   poll_timer_(-1)
 {
    line_ = 0;
    type_ = 0;
+   latency_file_ = nullptr;
+   dsv_given_ = false;
 
    int index = 1;
    for (; a[index]; index++) {
       if (a[index][0] != '-') break;
       if (a[index][1] == 't')
-         type_ = 1; }
+         type_ = 1;
+      else if (a[index][1] == 'l' && a[index + 1])
+         latency_file_ = a[++index];
+      else if (a[index][1] == 'd') {
+         if (!a[index + 1] || !Dsv::parse(a[index + 1], dsv_)) {
+            fprintf(stderr, "usage: e -d csv|tsv|SEP: SEP is one byte, "
+                            "not '\"'\n");
+            exit(2); }
+         dsv_given_ = true;
+         index++; } }
 
    const char *f0 = a[index];
    if (!f0) { filename_ = "e.txt"; return; }
@@ -11,6 +11,9 @@
 #include <sys/ioctl.h>
 
 #include "buf.h"
+#include "input.h"
+#include "loop.h"
+#include "view.h"
 
 namespace e {
 
@@ -20,12 +23,24 @@ public:
    void go();
 private:
    void mainloop();
+   bool key(View &v, int cmd);
+   void redraw();
+   void draw();
 
    const char *filename_;
    int line_;
    int type_;
+   const char *latency_file_;    // -l
+   Dsv  dsv_;                    // -d
+   bool dsv_given_;
 
    Buf *buf_;
+   Input input_;
+   Loop  loop_;
+   View *view_;
+   int   prev_cmd_;
+   long  last_frame_;
+   int   frame_timer_, poll_timer_;
 };
 
 } // namespace
@@ -1,10 +1,14 @@
 #include <termios.h>
 #include <fcntl.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #include <libgen.h>
 #include <cstring>
 #include <cstdio>
+#include <cstdlib>
+#include <climits>
+#include <chrono>
 #include <vector>
 #include <iostream>
 #include <algorithm>
@@ -13,95 +17,384 @@
 #include "str.h"
 #include "buf.h"
 
-namespace {
+namespace e {
 
-char
-chop(char *s)
+Buf::Buf(const char *filename) :
+   hits_(lines),
+   cols_(lines),
+   dirty_(false),
+   changes_(0),
+   new_file_(false),
+   map_(nullptr),
+   map_size_(0),
+   taken_pos_(0),
+   loading_(false),
+   load_done_(false),
+   load_cancel_(false),
+   load_pos_(0)
 {
-   char c;
-   int  l;
+   filename_ = strdup(filename);
+
+   int fd = open(filename, O_RDONLY);
+   if (fd == -1) {
+      new_file_ = true;
+      return; }
 
-   l = strlen(s);
-   if (!l) return '\0';
-   l--;
-   c = s[l];
-   s[l] = '\0';
-   return c;
+   if (!load_map(fd))
+      load_stream(fd);
+   close(fd);
 }
 
+Buf::~Buf()
+{
+   if (loading_) {
+      load_cancel_ = true;
+      loader_.join(); }
+   hits_.stop();
+   cols_.stop();
+   fields_.clear();
+   lines.each([this](const Span &s) { drop(s); });
+   if (map_) munmap(map_, map_size_);
+   free((void *)filename_);
 }
 
-namespace e {
+bool
+Buf::load_map(int fd)
+{
+   struct stat st;
+   if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) || !st.st_size)
+      return false;
+
+   void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   if (p == MAP_FAILED) return false;
+   map_      = (char *)p;
+   map_size_ = st.st_size;
+
+   hits_.text(map_, map_size_);
+   cols_.text(map_, map_size_);
+   loading_ = true;
+   loader_  = std::thread([this]() { load_split(); });
+   return true;
+}
 
-Buf::Buf(const char *filename) : dirty_(false), new_file_(false)
+// small batches first, so the first screen is there soon
+void
+Buf::load_split()
 {
-   filename_ = strdup(filename);
+   std::vector<Span> v;
+   size_t batch = 1024;
+   const char *s = map_, *end = map_ + map_size_;
+   while (s < end && !load_cancel_) {
+      auto nl = (const char *)memchr(s, '\n', end - s);
+      if (!nl) nl = end;
+      v.push_back(Span { s, int(nl - s) });
+      s = nl + 1;
+      if (v.size() < batch && s < end) continue;
 
-   FILE *f = fopen(filename, "r");
-   if (!f) {
-      new_file_ = true;
-      return; }
+      std::lock_guard<std::mutex> l(load_mutex_);
+      split_.insert(split_.end(), v.begin(), v.end());
+      load_cond_.notify_all();
+      v.clear();
+      if (batch < 65536) batch *= 2; }
+
+   std::lock_guard<std::mutex> l(load_mutex_);
+   load_done_ = true;
+   load_cond_.notify_all();
+}
+
+bool
+Buf::sync(int ms)
+{
+   if (!loading_) return false;
+   using clock = std::chrono::steady_clock;
+   const auto until = clock::now() + std::chrono::milliseconds(ms);
+   const size_t slice = 16384;
+
+   for (;;) {
+      if (taken_pos_ == taken_.size()) {
+         std::lock_guard<std::mutex> l(load_mutex_);
+         taken_.clear();
+         taken_pos_ = 0;
+         taken_.swap(split_);
+         if (taken_.empty()) {
+            if (!load_done_) return true;
+            break; } }
 
-   char b[160];
-   while (fgets(b, sizeof b, f)) {
-      chop(b);
-      lines.push_back(strdup(b)); }
+      // room for as many more lines as the first ones suggest, so orig_
+      // does not keep moving as it grows
+      if (!lines.loaded()) {
+         const Span &l = taken_.back();
+         lines.reserve(map_size_ * 9 / 8 * taken_.size() / (l.s + l.size + 1 - map_)); }
+
+      const size_t n = std::min(taken_.size() - taken_pos_, slice);
+      const Span &l = taken_[taken_pos_ + n - 1];
+      lines.append(&taken_[taken_pos_], n);
+      taken_pos_ += n;
+      load_pos_ = l.s + l.size - map_;
+      if (ms >= 0 && clock::now() >= until) return true; }
+
+   loader_.join();
+   loading_ = false;
+   std::vector<Span>().swap(taken_);
+   return false;
+}
+
+void
+Buf::wait_lines(int n)
+{
+   while (sync() && lines.size() < n) {
+      std::unique_lock<std::mutex> l(load_mutex_);
+      load_cond_.wait(l, [this]() { return !split_.empty() || load_done_; }); }
+}
+
+void
+Buf::wait_loaded()
+{
+   wait_lines(INT_MAX);
+}
+
+void
+Buf::load_stream(int fd)
+{
+   FILE *f = fdopen(dup(fd), "r");
+   if (!f) return;
+
+   std::vector<Span> v;
+   char   *b = nullptr;
+   size_t  n = 0;
+   ssize_t l;
+   while ((l = getline(&b, &n, f)) != -1) {
+      if (l && b[l - 1] == '\n') b[--l] = '\0';
+      v.push_back(Span { arena_.dup(b, l), int(l) }); }
+   free(b);
+   lines.append(v);
+   fclose(f);
+}
+
+void
+Buf::drop(Span s)
+{
+   delete[] s.marks;
+   if (!fields_.empty()) fields_.erase(s.s);
+   if (!mapped(s.s) && !arena_.owns(s.s)) line_free(s.s, s.size);
+}
+
+void
+Buf::put_lines(FILE *f)
+{
+   lines.each([f](const Span &s) {
+      fwrite(s.s, 1, s.size, f);
+      fputc('\n', f); });
 }
 
 void
 Buf::save()
 {
+   wait_loaded();
+   if (map_) {
+      if (save_mapped()) dirty_ = new_file_ = false;
+      return; }
+
    FILE *f = fopen(filename_, "w");
    if (!f) return;
 
-   for (auto i : lines) {
-      fputs(i,    f);
-      fputc('\n', f); }
+   put_lines(f);
    if (fclose(f) == EOF) return;
    dirty_ = new_file_ = false;
 }
 
+// Truncating the file under the mapping would fault the lines still in it,
+// so write a sibling and rename it over: next to the file a symlink points
+// to, with its owner and mode.  A file with other links, or someone else's
+// (or a group we are not in), is written in place instead, once the mapped
+// lines are copies.
+bool
+Buf::save_mapped()
+{
+   char *real = realpath(filename_, nullptr);
+   const char *name = real ? real : filename_;
+   struct stat st;
+   const bool found = stat(name, &st) == 0;
+   const bool ok = found && (st.st_nlink > 1 || st.st_uid != geteuid()) ?
+                   save_in_place(name) : save_renamed(name, found ? &st : nullptr);
+   free(real);
+   return ok;
+}
+
+bool
+Buf::save_renamed(const char *name, const struct stat *st)
+{
+   std::vector<char> tmp(name, name + strlen(name));
+   const char suffix[] = ".XXXXXX";
+   tmp.insert(tmp.end(), suffix, suffix + sizeof suffix);
+
+   int fd = mkstemp(tmp.data());
+   if (fd == -1) return false;
+   if (st && fchown(fd, st->st_uid, st->st_gid) == -1) {
+      // a group it cannot have
+      close(fd);
+      unlink(tmp.data());
+      return save_in_place(name); }
+   if (st) fchmod(fd, st->st_mode & 07777);
+
+   FILE *f = fdopen(fd, "w");
+   if (!f) { close(fd); unlink(tmp.data()); return false; }
+
+   put_lines(f);
+   if (fclose(f) == EOF || rename(tmp.data(), name) == -1) {
+      unlink(tmp.data());
+      return false; }
+   return true;
+}
+
+// Truncating the file takes even private copies of its pages out of the
+// mapping, so the image moves to anonymous memory at the same address.
+bool
+Buf::save_in_place(const char *name)
+{
+   hits_.wait();
+   cols_.wait();
+   void *p = mmap(nullptr, map_size_, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if (p == MAP_FAILED) return false;
+   memcpy(p, map_, map_size_);
+   mprotect(p, map_size_, PROT_READ);
+   if (mremap(p, map_size_, map_size_, MREMAP_MAYMOVE | MREMAP_FIXED, map_) ==
+       MAP_FAILED) {
+      munmap(p, map_size_);
+      return false; }
+
+   FILE *f = fopen(name, "w");
+   if (!f) return false;
+   put_lines(f);
+   return fclose(f) != EOF;
+}
+
 void
-Buf::show(std::vector<const char *> &v, int from, int to)
+Buf::show(std::vector<Span> &v, int from, int to)
 {
-   int n = 0;
-   for (auto i : lines) {
-      if (n >= from && n < to) {
-         v.push_back(i); }
-      ++n; }
+   for (int n = from < 0 ? 0 : from; n < to && n < lines.size(); n++)
+      v.push_back(get_line(n));
 }
 
 void
 Buf::delete_line(int n)
 {
-   auto i = lines.begin() + n;
-   free((void *)*i);
+   const Span s = lines.erase(n);
+   cols_.removed(s);
+   drop(s);
+   dirty_ = true;
+   changes_++;
+}
 
-   lines.erase(i);
+// past the lines loaded so far is the end of the file, once all are in;
+// lines loaded later would otherwise come after this one
+int
+Buf::insert_empty_line(int n)
+{
+   if (n >= lines.size() && loading_) {
+      wait_loaded();
+      n = lines.size(); }
+   Span s { line_new(0), 0 };
+   measure(s);
+   lines.insert(n, s);
+   cols_.added(s);
    dirty_ = true;
+   changes_++;
+   return n;
 }
 
 void
-Buf::insert_empty_line(int n)
+Buf::replace_line(int n, Span s)
+{
+   s.marks = nullptr;
+   measure(s);
+   const Span l = lines.replace(n, s);
+   cols_.removed(l);
+   cols_.added(s);
+   drop(l);
+   hits_.changed(n);
+   dirty_ = true;
+   changes_++;
+}
+
+// s goes in at byte b of line n; its line breaks (\n, \r or \r\n) split
+// the line.  Returns how many there were.
+int
+Buf::insert_text(int n, int b, const char *s, int size)
 {
-   auto i = lines.begin() + n;
-   auto s = strdup("");
+   const Span l = get_line(n);
+   const char *end = s + size;
 
-   lines.insert(i, s);
+   std::vector<Span> v;
+   for (const char *p = s; ; ) {
+      const char *e = p;
+      while (e < end && *e != '\n' && *e != '\r') e++;
+      const int head = v.empty() ? b : 0;
+      const int tail = e == end ? l.size - b : 0;
+      char *t = line_new(head + (e - p) + tail);
+      memcpy(t, l.s, head);
+      memcpy(t + head, p, e - p);
+      memcpy(t + head + (e - p), l.s + b, tail);
+      v.push_back(Span { t, head + int(e - p) + tail });
+      measure(v.back());
+      if (e == end) break;
+      p = e + (e + 1 < end && e[0] == '\r' && e[1] == '\n' ? 2 : 1); }
+
+   cols_.removed(l);
+   for (auto &t : v)
+      cols_.added(t);
+   drop(lines.replace(n, v[0]));
+   hits_.changed(n);
+   std::vector<Span> rest(v.begin() + 1, v.end());
+   lines.insert(n + 1, rest);
+   for (int i = 1; i < (int)v.size(); i++)
+      hits_.changed(n + i);
    dirty_ = true;
+   changes_++;
+   return v.size() - 1;
 }
 
 void
-Buf::replace_line(int n, const char* s)
+Buf::transpose_lines(int n)
 {
-   lines.at(n) = s;
+   lines.swap(n, n + 1);
    dirty_ = true;
+   changes_++;
 }
 
-const char *
+// loaded lines are measured when first asked for, edited ones as they
+// come in; long lines get their checkpoints on first use either way
+Span
 Buf::get_line(int n)
 {
-   return lines.at(n);
+   auto &l = lines.at(n);
+   if (l.len < 0) measure(l);
+   if (!l.marks && l.size >= Str::mark_min) l.marks = mark(l);
+   return l;
+}
+
+// rebuilt from scratch once many rows have one, the table view only ever
+// needs a window's worth
+const Fields &
+Buf::fields(int n)
+{
+   const Span l = get_line(n);
+   auto i = fields_.find(l.s);
+   if (i != fields_.end()) return i->second;
+   if (fields_.size() >= 4096) fields_.clear();
+   Fields &f = fields_[l.s];
+   split_fields(l, dsv_, f);
+   return f;
+}
+
+void
+Buf::dsv(Dsv d)
+{
+   if (d == dsv_) return;
+   dsv_ = d;
+   fields_.clear();
+   cols_.dsv(d);
 }
 
 const char *
@@ -113,7 +406,7 @@ Buf::filename()
 int
 Buf::line_length(int n)
 {
-   return n < 0 || n >= lines.size() ? 0 : Str(lines[n]).len();
+   return n < 0 || n >= lines.size() ? 0 : get_line(n).len;
 }
 
 } // namespace
@@ -2,30 +2,99 @@
 #define buf_h
 
 #include <vector>
+#include <unordered_map>
+#include <cstddef>
+#include <cstdio>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <sys/stat.h>
+
+#include "alloc.h"
+#include "span.h"
+#include "lines.h"
+#include "hits.h"
+#include "fields.h"
+#include "columns.h"
 
 namespace e {
 
 class Buf {
 public:
    Buf(const char *filename);
+   ~Buf();
    void save();
    bool dirty()    { return dirty_; }
+   long changes()  { return changes_; }   // edits so far
    bool new_file() { return new_file_; }
-   void show(std::vector<const char *> &v, int from, int to);
+   void show(std::vector<Span> &v, int from, int to);
+
+   // A mapped file is split into lines on a worker thread and they show
+   // up in batches: sync() appends the ones split so far, or as many as
+   // it can in ms.
+   bool loading()      { return loading_; }
+   int  load_percent() { return map_size_ ? 100 * load_pos_ / map_size_ : 100; }
+   bool sync(int ms = -1);      // true while there are more to come
+   void wait_lines(int n);      // until there are n, or all of them
+   void wait_loaded();
 
    void delete_line(int n);
-   void insert_empty_line(int n);
-   void replace_line(int n, const char* s);
+   int  insert_empty_line(int n);       // returns where it went
+   void replace_line(int n, Span s);    // takes s, drops old line
+   void transpose_lines(int n);         // swap lines n and n + 1
+   int  insert_text(int n, int b, const char *s, int size);
 
    int num_of_lines() { return lines.size(); }
    int line_length(int n);
    const char *filename();
-   const char *get_line(int n);
+   Span get_line(int n);
+   Span raw_line(int n) { return lines.at(n); }  // not measured
+   // in the file image or the load arena, not freed before the Buf is
+   bool kept(const char *s) { return mapped(s) || arena_.owns(s); }
+   const Fields &fields(int n);         // of line n; valid until the next call
+   Dsv  dsv() { return dsv_; }
+   void dsv(Dsv d);                     // how rows split from now on
+   Hits &hits() { return hits_; }
+   Columns &columns() { return cols_; }
 private:
    const char *filename_;
-   std::vector<const char *> lines;
+   Lines lines;
+   Hits  hits_;
+   Columns cols_;
    bool dirty_;
+   long changes_;
    bool new_file_;
+
+   // file image; unedited lines point into it
+   char  *map_;
+   size_t map_size_;
+   Arena  arena_;   // loaded lines that could not be mapped
+
+   // field index of the rows the table view has been to, by line text;
+   // a line's goes when it is dropped
+   Dsv dsv_;
+   std::unordered_map<const char *, Fields> fields_;
+
+   std::thread loader_;
+   std::mutex  load_mutex_;
+   std::condition_variable load_cond_;
+   std::vector<Span> split_;        // by loader_, not yet taken
+   std::vector<Span> taken_;        // by sync(), appended up to taken_pos_
+   size_t taken_pos_;
+   bool loading_, load_done_;       // load_done_: loader_ has finished
+   std::atomic<bool> load_cancel_;
+   size_t load_pos_;                // bytes appended so far
+
+   bool load_map(int fd);
+   void load_split();
+   void load_stream(int fd);
+   bool mapped(const char *s) { return s >= map_ && s < map_ + map_size_; }
+   void drop(Span s);
+   void put_lines(FILE *f);
+   bool save_mapped();
+   bool save_renamed(const char *name, const struct stat *st);
+   bool save_in_place(const char *name);
 };
 
 } // namespace
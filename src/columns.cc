@@ -0,0 +1,143 @@
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#include "utf8.h"
+#include "columns.h"
+
+namespace e {
+
+// d for the width of each field of l, in its column
+void
+Columns::count(Span l, Dsv dsv, int d, std::vector<Hist> &h, Fields &f)
+{
+   split_fields(l, dsv, f);
+   const int n = std::min(f.count(), (int)max_columns);
+   if (n > (int)h.size()) h.resize(n, Hist {});
+   for (int k = 0; k < n; k++) {
+      const int w = k < f.count() - 1 ? f.chars[k] - f.start(k) :
+                    utf8_count(l.s + f.start_byte(k), l.size - f.start_byte(k));
+      h[k][w < max_width ? w : max_width] += d; }
+}
+
+void
+Columns::percentile(int p)
+{
+   percentile_ = p < 1 ? 1 : p > 100 ? 100 : p;
+   stale_ = true;
+}
+
+// a new way of splitting rows: all of them, over again
+void
+Columns::dsv(Dsv d)
+{
+   if (d == dsv_) return;
+   stop();
+   dsv_ = d;
+   image_.clear();
+   diff_.clear();
+   stale_ = true;
+   if (built_) {
+      built_ = false;
+      build(); }
+}
+
+void
+Columns::stop()
+{
+   if (!building_) return;
+   cancel_ = true;
+   worker_.join();
+   building_ = false;
+}
+
+void
+Columns::build()
+{
+   if (built_) return;
+   built_ = true;
+
+   // the worker only sees the file image: all of it, or once edits have
+   // taken lines of it away or copied them, those still in the buffer
+   // and the ones not loaded yet
+   std::vector<Span> kept;
+   lines_.each([&](const Span &s) {
+      if (!image(s.s)) count(s, dsv_, +1, diff_, fields_);
+      else if (image_edited_) kept.push_back(s); });
+   stale_ = true;
+   if (!text_) return;
+
+   building_ = true;
+   done_ = cancel_ = false;
+   const int loaded = image_edited_ ? lines_.loaded() : 0;
+   worker_ = std::thread([this, kept = std::move(kept), loaded]() {
+      Fields f;
+      for (size_t i = 0; i < kept.size() && !cancel_; i++)
+         count(kept[i], dsv_, +1, image_, f);
+      const char *s = text_, *end = text_ + text_size_;
+      for (int i = 0; s < end && !cancel_; i++) {
+         auto nl = (const char *)memchr(s, '\n', end - s);
+         if (!nl) nl = end;
+         if (i >= loaded) count(Span { s, int(nl - s) }, dsv_, +1, image_, f);
+         s = nl + 1; }
+      done_ = true; });
+}
+
+bool
+Columns::ready()
+{
+   if (building_ && done_) wait();
+   return !building_;
+}
+
+void
+Columns::wait()
+{
+   if (building_) {
+      worker_.join();
+      building_ = false;
+      stale_ = true; }
+}
+
+void
+Columns::added(Span s)
+{
+   if (image(s.s)) image_edited_ = true;
+   if (!built_) return;
+   count(s, dsv_, +1, diff_, fields_);
+   stale_ = true;
+}
+
+void
+Columns::removed(Span s)
+{
+   if (image(s.s)) image_edited_ = true;
+   if (!built_) return;
+   count(s, dsv_, -1, diff_, fields_);
+   stale_ = true;
+}
+
+// until the image is counted, every column is as wide as it has always been
+int
+Columns::width(int k)
+{
+   if (!built_ || !ready() || k >= max_columns) return fallback(k);
+   if (stale_) {
+      widths_.clear();
+      const size_t n = std::max(image_.size(), diff_.size());
+      for (size_t c = 0; c < n; c++) {
+         Hist h {};
+         long rows = 0;
+         for (int w = 0; w <= max_width; w++) {
+            if (c < image_.size()) h[w] += image_[c][w];
+            if (c < diff_.size())  h[w] += diff_[c][w];
+            rows += h[w]; }
+         const long rank = std::ceil(rows * percentile_ / 100.0);
+         int w = 0;
+         for (long seen = 0; w < max_width && (seen += h[w]) < rank; w++) ;
+         widths_.push_back(rows ? std::max(w, 1) : fallback(c)); }
+      stale_ = false; }
+   return k < (int)widths_.size() ? widths_[k] : fallback(k);
+}
+
+} // namespace
@@ -0,0 +1,72 @@
+#ifndef columns_h
+#define columns_h
+
+#include <array>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cstddef>
+
+#include "span.h"
+#include "lines.h"
+#include "fields.h"
+
+namespace e {
+
+// Column widths for the table view, from how many rows have a field of
+// each width (in chars) in each column, over the whole buffer.  The file
+// image is counted on a worker thread the first time they are asked for;
+// lines that are not in it, and lines of it that have been edited away,
+// are counted on the spot as a difference.  A column is as wide as its
+// widest field, or as a chosen percentile of them.
+class Columns {
+public:
+   static const int max_width   = 64;    // wider fields count as this
+   static const int max_columns = 256;   // the rest keep the default
+
+   Columns(Lines &lines) : lines_(lines), text_(nullptr), text_size_(0),
+      percentile_(100), built_(false), building_(false), done_(false),
+      cancel_(false), image_edited_(false), stale_(true) { }
+   ~Columns() { stop(); }
+   Columns(const Columns &) = delete;
+   Columns &operator=(const Columns &) = delete;
+
+   void text(const char *s, size_t size) { text_ = s; text_size_ = size; }
+   void percentile(int p);     // 100 for the widest field
+   void dsv(Dsv d);            // counted again, if they have been
+   void build();               // once; the first time they are needed
+   void stop();
+   bool ready();               // not counting on the worker
+   void wait();
+   void added(Span s);         // s has come into the buffer
+   void removed(Span s);       // and gone out of it
+   int  width(int k);          // of fields in column k, 1 or more
+
+private:
+   typedef std::array<int, max_width + 1> Hist;
+
+   Lines &lines_;
+   const char *text_;
+   size_t text_size_;
+   int percentile_;
+   Dsv dsv_;
+   Fields fields_;             // split here, not by the worker
+
+   bool built_, building_;
+   std::thread worker_;
+   std::atomic<bool> done_, cancel_;
+   std::vector<Hist> image_;   // the file image, by the worker
+   std::vector<Hist> diff_;    // what the rest adds to it, or takes away
+   bool image_edited_;         // lines of it have come or gone by an edit
+
+   bool stale_;
+   std::vector<int> widths_;
+
+   bool image(const char *s) { return s >= text_ && s < text_ + text_size_; }
+   static void count(Span l, Dsv dsv, int d, std::vector<Hist> &h, Fields &f);
+   static int  fallback(int k) { return k ? 15 : 16; }
+};
+
+} // namespace
+
+#endif
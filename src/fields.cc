@@ -0,0 +1,184 @@
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define FIELDS_X86 1
+#endif
+
+#include "utf8.h"
+#include "fields.h"
+
+namespace e {
+
+bool
+Dsv::parse(const char *s, Dsv &d)
+{
+   if (!strcmp(s, "csv"))
+      d = Dsv { ',', true };
+   else if (!strcmp(s, "tsv") || !strcmp(s, "\\t"))
+      d = Dsv { '\t', false };
+   else if (s[0] && !s[1] && s[0] != '"')
+      d = Dsv { s[0], false };
+   else
+      return false;
+   return true;
+}
+
+namespace {
+
+inline bool lead(char c) { return (c & 0xc0) != 0x80; }
+
+// how far a row is split: byte i is next, with c chars before it, and in
+// is set between quotes
+struct Split { int i, c; bool in; };
+
+inline void
+push(Fields &f, int b, int c)
+{
+   f.bytes.push_back(b);
+   f.chars.push_back(c);
+}
+
+void
+scalar_rest(Span l, Dsv d, Split &st, Fields &f)
+{
+   const bool ascii = l.flags & Span::ascii;
+   for (; st.i < l.size; st.i++) {
+      const char c = l.s[st.i];
+      if (c == '"' && d.quoted) st.in = !st.in;
+      else if (c == d.sep && !st.in) push(f, st.i, st.c);
+      if (ascii || lead(c)) st.c++; }
+}
+
+void
+scalar_split(Span l, Dsv d, Fields &f)
+{
+   f.bytes.clear();
+   f.chars.clear();
+   if (d.quoted) {
+      Split st { 0, 0, false };
+      return scalar_rest(l, d, st, f); }
+
+   const char *s = l.s, *end = l.s + l.size;
+   int b = 0, c = 0;
+   while (auto p = (const char *)memchr(s + b, d.sep, end - (s + b))) {
+      const int e = p - s;
+      c += l.flags & Span::ascii ? e - b : utf8_count(s + b, e - b);
+      push(f, e, c);
+      b = e + 1;
+      c++; }
+}
+
+#ifdef FIELDS_X86
+
+// A block of w bytes at a time: a compare each for the separators, the
+// quotes and (as utf8.cc) the char starts gives a bit mask of each.  A
+// prefix XOR of the quotes marks the bytes between them, whose separators
+// do not count; what is left is walked a bit at a time.
+
+#define FIELDS_INLINE inline __attribute__((always_inline))
+
+FIELDS_INLINE void
+block(unsigned seps, unsigned quotes, unsigned leads, int w, bool ascii,
+      Split &st, Fields &f)
+{
+   if (quotes || st.in) {
+      unsigned x = quotes;
+      for (int s = 1; s < w; s <<= 1) x ^= x << s;
+      if (st.in) x = ~x;
+      seps &= ~x;
+      st.in = x >> (w - 1) & 1; }
+   for (; seps; seps &= seps - 1) {
+      const int j = __builtin_ctz(seps);
+      push(f, st.i + j, st.c + (ascii ? j : __builtin_popcount(leads & ((1u << j) - 1)))); }
+   st.c += ascii ? w : __builtin_popcount(leads);
+   st.i += w;
+}
+
+FIELDS_INLINE void
+sse2_body(Span l, Dsv d, Split &st, Fields &f)
+{
+   const __m128i vs = _mm_set1_epi8(d.sep), vq = _mm_set1_epi8('"'),
+                 k  = _mm_set1_epi8(-65);
+   const bool ascii = l.flags & Span::ascii;
+
+   while (l.size - st.i >= 16) {
+      __m128i v = _mm_loadu_si128((const __m128i *)(l.s + st.i));
+      block(_mm_movemask_epi8(_mm_cmpeq_epi8(v, vs)),
+            d.quoted ? _mm_movemask_epi8(_mm_cmpeq_epi8(v, vq)) : 0,
+            ascii ? 0 : _mm_movemask_epi8(_mm_cmpgt_epi8(v, k)),
+            16, ascii, st, f); }
+}
+
+void
+sse2_split(Span l, Dsv d, Fields &f)
+{
+   f.bytes.clear();
+   f.chars.clear();
+   Split st { 0, 0, false };
+   sse2_body(l, d, st, f);
+   scalar_rest(l, d, st, f);
+}
+
+__attribute__((target("avx2,popcnt"))) void
+avx2_split(Span l, Dsv d, Fields &f)
+{
+   f.bytes.clear();
+   f.chars.clear();
+   const __m256i vs = _mm256_set1_epi8(d.sep), vq = _mm256_set1_epi8('"'),
+                 k  = _mm256_set1_epi8(-65);
+   const bool ascii = l.flags & Span::ascii;
+   Split st { 0, 0, false };
+
+   while (l.size - st.i >= 32) {
+      __m256i v = _mm256_loadu_si256((const __m256i *)(l.s + st.i));
+      block(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, vs)),
+            d.quoted ? _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, vq)) : 0,
+            ascii ? 0 : _mm256_movemask_epi8(_mm256_cmpgt_epi8(v, k)),
+            32, ascii, st, f); }
+   sse2_body(l, d, st, f);
+   scalar_rest(l, d, st, f);
+}
+
+#endif
+
+const FieldsKernel *
+choose()
+{
+#ifdef FIELDS_X86
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+      return &fields_kernels[2];
+   return &fields_kernels[1];
+#else
+   return &fields_kernels[0];
+#endif
+}
+
+const FieldsKernel *kernel = &fields_kernels[0];
+const bool chosen = (kernel = choose(), true);
+
+}
+
+const FieldsKernel fields_kernels[] = {
+   { "scalar", scalar_split },
+#ifdef FIELDS_X86
+   { "sse2",   sse2_split },
+   { "avx2",   avx2_split },
+#endif
+   { nullptr,  nullptr },
+};
+
+const FieldsKernel &
+fields_kernel()
+{
+   return *kernel;
+}
+
+void
+split_fields(Span l, Dsv d, Fields &f)
+{
+   kernel->split(l, d, f);
+}
+
+} // namespace
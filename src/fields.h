@@ -0,0 +1,53 @@
+#ifndef fields_h
+#define fields_h
+
+#include <vector>
+#include <algorithm>
+
+#include "span.h"
+
+namespace e {
+
+// How a DSV row splits: at sep, and if quoted, not between double quotes
+// (as in RFC 4180 CSV, where "" is a quote inside them).  A row is a line;
+// a quoted field does not go on to the next one.
+struct Dsv {
+   char sep = ':';
+   bool quoted = false;
+
+   bool operator==(const Dsv &d) const { return sep == d.sep && quoted == d.quoted; }
+   bool operator!=(const Dsv &d) const { return !(*this == d); }
+   static bool parse(const char *s, Dsv &d);   // csv, tsv or a char
+};
+
+// Where a DSV row's fields are: the byte and char offset of every
+// separator, in order.  Field k runs from just after separator k - 1 up
+// to separator k (or the end of the row).
+struct Fields {
+   std::vector<int> bytes, chars;
+
+   int count() const { return chars.size() + 1; }
+   // the field char col is in; a separator ends the field before it
+   int field(int col) const {
+      return std::lower_bound(chars.begin(), chars.end(), col) - chars.begin(); }
+   int start(int k) const { return k ? chars[k - 1] + 1 : 0; }      // chars
+   int start_byte(int k) const { return k ? bytes[k - 1] + 1 : 0; }
+   int end_byte(int k, Span l) const { return k < count() - 1 ? bytes[k] : l.size; }
+   bool separator(int col) const {
+      return std::binary_search(chars.begin(), chars.end(), col); }
+};
+
+void split_fields(Span l, Dsv d, Fields &f);   // l measured or not
+
+// the implementations split_fields() chooses from at start-up
+struct FieldsKernel {
+   const char *name;
+   void (*split)(Span l, Dsv d, Fields &f);
+};
+
+extern const FieldsKernel fields_kernels[];   // ends with a null name
+const FieldsKernel &fields_kernel();          // the one in use
+
+} // namespace
+
+#endif
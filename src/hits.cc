@@ -0,0 +1,104 @@
+#include <cstring>
+#include <memory>
+
+#include "keywords.h"
+#include "hits.h"
+
+namespace e {
+
+void
+Hits::stop()
+{
+   if (!building_) return;
+   cancel_ = true;
+   if (worker_.joinable()) worker_.join();
+   building_ = false;
+   found_.clear();
+   installed_ = 0;
+}
+
+void
+Hits::rebuild()
+{
+   stop();
+   lines_.clear_weights();
+   if (keywords.empty()) return;
+
+   // the worker only sees the file image
+   int n = 0;
+   lines_.each([this, &n](const Span &s) {
+      if (!loaded(s.s))
+         if (int c = keywords.count(s)) lines_.set_weight(n, c);
+      n++; });
+   if (!text_) return;
+
+   std::shared_ptr<Keywords> k(new Keywords(keywords));
+   building_ = true;
+   done_ = cancel_ = false;
+   worker_ = std::thread([this, k]() {
+      const char *s = text_, *end = text_ + text_size_;
+      int slot = 0;
+      for (; s < end && !cancel_; slot++) {
+         auto nl = (const char *)memchr(s, '\n', end - s);
+         if (!nl) nl = end;
+         if (int c = k->count(Span { s, int(nl - s) }))
+            found_.push_back(Found { slot, c, s });
+         s = nl + 1; }
+      slots_ = slot;
+      done_ = true; });
+}
+
+void
+Hits::changed(int n)
+{
+   if (!keywords.empty()) lines_.set_weight(n, keywords.count(lines_.at(n)));
+}
+
+bool
+Hits::ready()
+{
+   if (building_ && done_) install();
+   return !building_;
+}
+
+void
+Hits::wait()
+{
+   if (building_) install();
+}
+
+// slots edited meanwhile no longer hold the text that was scanned and
+// keep their own counts; ones not loaded yet get theirs on a later call
+void
+Hits::install()
+{
+   if (worker_.joinable()) worker_.join();
+   const int loaded = lines_.loaded();
+   size_t i = installed_;
+   for (; i < found_.size() && found_[i].slot < loaded; i++)
+      lines_.set_loaded_weight(found_[i].slot, found_[i].s, found_[i].count);
+   if (i > installed_) lines_.update_weights();
+   installed_ = i;
+   if (loaded < slots_) return;
+
+   building_ = false;
+   installed_ = 0;
+   found_.clear();
+   found_.shrink_to_fit();
+}
+
+int
+Hits::next(int n)
+{
+   const int k = lines_.weight_before(n < 0 ? 0 : n + 1);
+   return k < total() ? lines_.find_weight(k) : -1;
+}
+
+int
+Hits::prev(int n)
+{
+   const int k = n <= 0 ? 0 : lines_.weight_before(n);
+   return k ? lines_.find_weight(k - 1) : -1;
+}
+
+} // namespace
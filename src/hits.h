@@ -0,0 +1,58 @@
+#ifndef hits_h
+#define hits_h
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cstddef>
+
+#include "lines.h"
+
+namespace e {
+
+// Keyword hits over the whole buffer, kept as line weights in Lines so the
+// next or previous hit from anywhere is O(log n) away.  When the keyword
+// set changes the file image is rescanned on a worker thread while edited
+// lines are counted on the spot; edits after that recount just their line.
+// While the file is still being loaded, counts for lines not yet appended
+// wait until they are.
+class Hits {
+public:
+   Hits(Lines &lines) : lines_(lines), text_(nullptr), text_size_(0),
+      building_(false), done_(false), cancel_(false), slots_(0),
+      installed_(0) { }
+   ~Hits() { stop(); }
+   Hits(const Hits &) = delete;
+   Hits &operator=(const Hits &) = delete;
+
+   void text(const char *s, size_t size) { text_ = s; text_size_ = size; }
+   void rebuild();             // the keyword set changed
+   void changed(int n);        // line n has new contents
+   void stop();
+   bool ready();               // installs a finished scan
+   void wait();                // as far as the lines loaded so far
+   int  total() { return lines_.weight_total(); }
+   int  next(int n);           // next line after n with a hit, or -1
+   int  prev(int n);           // last line before n with one, or -1
+
+private:
+   struct Found { int slot, count; const char *s; };
+
+   Lines &lines_;
+   const char *text_;          // loaded lines, in slot order
+   size_t text_size_;
+
+   std::thread worker_;
+   bool building_;
+   std::atomic<bool> done_, cancel_;
+   std::vector<Found> found_;
+   int    slots_;              // lines in the text, once done_
+   size_t installed_;          // found_ up to here are in lines_
+
+   bool loaded(const char *s) { return s >= text_ && s < text_ + text_size_; }
+   void install();
+};
+
+} // namespace
+
+#endif
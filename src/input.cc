@@ -0,0 +1,81 @@
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+#include "input.h"
+
+namespace e {
+
+namespace {
+
+const char paste_begin[] = "\033[200~";
+const char paste_end[]   = "\033[201~";
+
+}
+
+bool
+Input::fill(int timeout)
+{
+   buf_.erase(0, pos_);
+   pos_ = 0;
+
+   struct pollfd p { fd_, POLLIN, 0 };
+   int r;
+   while ((r = poll(&p, 1, timeout)) == -1 && errno == EINTR) ;
+   if (r <= 0) return false;
+
+   char b[4096];
+   ssize_t n;
+   while ((n = read(fd_, b, sizeof b)) == -1 && errno == EINTR) ;
+   if (n <= 0) {
+      eof_ = true;
+      return false; }
+   buf_.append(b, n);
+   return true;
+}
+
+bool
+Input::pending()
+{
+   return pos_ < buf_.size() || eof_ || fill(0);
+}
+
+// s is next in the input; a sequence cut short waits a little for the rest
+bool
+Input::starts(const char *s)
+{
+   const size_t n = strlen(s);
+   while (buf_.size() - pos_ < n) {
+      if (buf_.compare(pos_, std::string::npos, s, buf_.size() - pos_))
+         return false;
+      if (!fill(50)) return false; }
+   return !buf_.compare(pos_, n, s);
+}
+
+int
+Input::get()
+{
+   if (pos_ == buf_.size() && (eof_ || !fill(-1))) return EOF;
+
+   if (!starts(paste_begin))
+      return (unsigned char)buf_[pos_++];
+
+   pos_ += strlen(paste_begin);
+   text_.clear();
+   for (;;) {
+      const size_t e = buf_.find(paste_end, pos_);
+      if (e != std::string::npos) {
+         text_.append(buf_, pos_, e - pos_);
+         pos_ = e + strlen(paste_end);
+         return paste; }
+      // keep what might be the start of the end marker
+      const size_t keep = std::min(buf_.size() - pos_, strlen(paste_end) - 1);
+      text_.append(buf_, pos_, buf_.size() - pos_ - keep);
+      pos_ = buf_.size() - keep;
+      if (!fill(-1)) return paste; }
+}
+
+} // namespace
@@ -0,0 +1,33 @@
+#ifndef input_h
+#define input_h
+
+#include <string>
+
+namespace e {
+
+// Keys from the terminal, read as much at a time as there is.  A bracketed
+// paste (ESC [200~ ... ESC [201~) comes back whole as one key, paste, with
+// its text in text().
+class Input {
+public:
+   enum { paste = 0x100 };
+
+   Input(int fd) : fd_(fd), pos_(0), eof_(false) { }
+   int  get();                 // blocks; EOF at the end
+   bool pending();             // get() would not block
+   const std::string &text() { return text_; }
+
+private:
+   int fd_;
+   std::string buf_;
+   size_t pos_;
+   bool eof_;
+   std::string text_;
+
+   bool fill(int timeout);     // ms, -1 for ever; false on EOF or timeout
+   bool starts(const char *s);
+};
+
+} // namespace
+
+#endif
@@ -0,0 +1,131 @@
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+#include "keywords.h"
+
+namespace e {
+
+Keywords keywords;
+
+Keywords::Keywords(const Keywords &k)
+{
+   for (auto w : k.words_)
+      words_.push_back(strdup(w));
+   build();
+}
+
+Keywords::~Keywords()
+{
+   for (auto i : words_)
+      free((void *)i);
+}
+
+bool
+Keywords::toggle(const char *w, int size)
+{
+   auto i = std::find_if(words_.begin(), words_.end(), [=](const char *s) {
+         return !strncmp(s, w, size) && !s[size]; });
+   const bool add = i == words_.end();
+
+   if (add)
+      words_.push_back(strndup(w, size));
+   else {
+      free((void *)*i);
+      words_.erase(i); }
+   build();
+   return add;
+}
+
+void
+Keywords::build()
+{
+   sizes_.clear();
+   for (auto w : words_)
+      sizes_.push_back(strlen(w));
+
+   // bytes no keyword uses share class 0, which always leads back to the
+   // root
+   memset(class_, 0, sizeof class_);
+   classes_ = 1;
+   for (auto w : words_)
+      for (auto c = (const unsigned char *)w; *c; c++)
+         if (!class_[*c]) class_[*c] = classes_++;
+
+   // trie; -1 for a missing edge
+   next_.assign(classes_, -1);
+   out_.assign(1, -1);
+   depth_.assign(1, 0);
+   for (size_t w = 0; w < words_.size(); w++) {
+      int q = 0;
+      for (auto c = (const unsigned char *)words_[w]; *c; c++) {
+         const int e = q * classes_ + class_[*c];
+         if (next_[e] < 0) {
+            next_[e] = out_.size();
+            next_.resize(next_.size() + classes_, -1);
+            out_.push_back(-1);
+            depth_.push_back(depth_[q] + 1); }
+         q = next_[e]; }
+      out_[q] = w; }
+
+   // breadth first, fill the missing edges from the failure state
+   const int n = out_.size();
+   std::vector<int> fail(n, 0), queue;
+   dict_.assign(n, 0);
+   for (int c = 0; c < classes_; c++) {
+      int &t = next_[c];
+      if (t < 0) t = 0; else queue.push_back(t); }
+   for (size_t h = 0; h < queue.size(); h++) {
+      const int q = queue[h];
+      for (int c = 0; c < classes_; c++) {
+         int &t = next_[q * classes_ + c];
+         const int f = next_[fail[q] * classes_ + c];
+         if (t < 0) { t = f; continue; }
+         fail[t]  = f;
+         dict_[t] = out_[f] >= 0 ? f : dict_[f];
+         queue.push_back(t); } }
+}
+
+int
+Keywords::find(Span l, int from)
+{
+   int r = -1;
+   scan(l, from, [&r](int b0, int, const char *) { r = b0; return true; });
+   return r;
+}
+
+int
+Keywords::rfind(Span l, int before)
+{
+   int r = -1;
+   scan(l, 0, [&r, before](int b0, int, const char *) {
+         if (b0 < before) r = std::max(r, b0);
+         return false; });
+   return r;
+}
+
+int
+Keywords::count(Span l)
+{
+   int n = 0;
+   scan(l, 0, [&n](int, int, const char *) { n++; return false; });
+   return n;
+}
+
+const char *
+Keywords::match(Span l, int at)
+{
+   if (words_.empty() || at < 0 || at >= l.size) return nullptr;
+   auto s = (const unsigned char *)l.s;
+   if (at && letter(s[at - 1])) return nullptr;
+
+   // stay on the trie path from at: the automaton would otherwise fall
+   // back to a suffix
+   int q = 0, i = at;
+   for (; i < l.size && letter(s[i]); i++) {
+      q = next_[q * classes_ + class_[s[i]]];
+      if (depth_[q] != i + 1 - at) return nullptr; }
+   return i > at && out_[q] >= 0 ? words_[out_[q]] : nullptr;
+}
+
+} // namespace
@@ -0,0 +1,68 @@
+#ifndef keywords_h
+#define keywords_h
+
+#include <vector>
+#include <cctype>
+
+#include "span.h"
+
+namespace e {
+
+// The keyword set, compiled into an Aho-Corasick automaton whenever it
+// changes, so that one pass over a line finds every keyword in it.  Only
+// whole words count: a match must not have letters on either side.
+class Keywords {
+public:
+   Keywords() { build(); }
+   ~Keywords();
+   Keywords(const Keywords &k);
+   Keywords &operator=(const Keywords &) = delete;
+
+   bool toggle(const char *w, int size);  // true if w was added
+   const std::vector<const char *> &words() { return words_; }
+   bool empty() { return words_.empty(); }
+
+   // f(b0, b1, w) for every keyword w at bytes [b0, b1) of l, starting at
+   // or after byte from, in order; f returns true to stop
+   template <class F> void scan(Span l, int from, F f);
+   int find(Span l, int from);           // byte of the first one, -1 if none
+   int rfind(Span l, int before);        // byte of the last one before that
+   const char *match(Span l, int at);    // the keyword at byte at, if any
+   int count(Span l);                    // how many there are in l
+
+private:
+   std::vector<const char *> words_;
+   std::vector<int> sizes_;
+
+   // state q goes to next_[q * classes_ + class_[c]] on byte c; out_[q] is
+   // the word ending at q (-1 for none) and dict_[q] the next state down
+   // its suffix chain that ends one (0 for none)
+   unsigned char class_[256];
+   int classes_;
+   std::vector<int> next_, out_, dict_, depth_;
+
+   void build();
+   static bool letter(unsigned char c) { return isalpha(c); }
+};
+
+template <class F> void
+Keywords::scan(Span l, int from, F f)
+{
+   if (words_.empty()) return;
+   auto s = (const unsigned char *)l.s;
+
+   for (int i = from < 0 ? 0 : from, q = 0; i < l.size; i++) {
+      q = next_[q * classes_ + class_[s[i]]];
+      if (out_[q] < 0 && !dict_[q]) continue;
+      if (i + 1 < l.size && letter(s[i + 1])) continue;
+      for (int o = out_[q] >= 0 ? q : dict_[q]; o; o = dict_[o]) {
+         const int w = out_[o], b0 = i + 1 - sizes_[w];
+         if (b0 < from || (b0 && letter(s[b0 - 1]))) continue;
+         if (f(b0, i + 1, words_[w])) return; } }
+}
+
+extern Keywords keywords;
+
+} // namespace
+
+#endif
@@ -0,0 +1,147 @@
+#include <time.h>
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <ostream>
+
+#include "latency.h"
+
+namespace e {
+
+Latency latency;
+
+long
+Latency::now()
+{
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return t.tv_sec * 1000000000L + t.tv_nsec;
+}
+
+// below 2 << sub a bucket each; above, 1 << sub to every power of two
+int
+Latency::Hist::bucket(long v)
+{
+   if (v < (2 << sub)) return v < 0 ? 0 : v;
+   const int k = 63 - __builtin_clzl(v) - sub;
+   return (k << sub) + (v >> k);
+}
+
+long
+Latency::Hist::top(int b)
+{
+   if (b < (2 << sub)) return b;
+   const int k = (b >> sub) - 1;
+   return (((b & ((1 << sub) - 1)) + (1 << sub) + 1L) << k) - 1;
+}
+
+void
+Latency::Hist::add(long v)
+{
+   const int b = bucket(v);
+   if (b >= (int)n_.size()) n_.resize(b + 1);
+   n_[b]++;
+   count_++;
+   if (v > max_) max_ = v;
+}
+
+long
+Latency::Hist::quantile(double q)
+{
+   const long rank = std::ceil(q * count_);
+   long seen = 0;
+   for (int b = 0; b < (int)n_.size(); b++)
+      if ((seen += n_[b]) >= rank && n_[b])
+         return std::min(top(b), max_);
+   return max_;
+}
+
+void
+Latency::start(const char *file, bool live)
+{
+   if (file) file_ = file;
+   live_ = live;
+   on_   = file || live;
+}
+
+void
+Latency::command(int key, long ns)
+{
+   if (!on_) return;
+   Command &c = commands_[key];
+   c.h[edit].add(ns);
+   c.last[edit] = ns;
+   last_   = key;
+   framed_ = false;
+}
+
+// a frame belongs to the command before it; those with none (a resize,
+// the hit count coming in) go under "redraw"
+void
+Latency::frame(long show_ns, long write_ns, long n)
+{
+   if (!on_) return;
+   shown_ = framed_ ? -1 : last_;
+   Command &c = commands_[shown_];
+   const long v[] = { show_ns, write_ns, n };
+   for (int k = show; k < kinds; k++) {
+      c.h[k].add(v[k - show]);
+      c.last[k] = v[k - show]; }
+   framed_ = true;
+}
+
+// " [^n 12+340+80us]": the View method, show() and the write, for the
+// frame before this one
+void
+Latency::out(std::ostream &o)
+{
+   auto i = commands_.find(shown_);
+   if (i == commands_.end()) return;
+   const long *l = i->second.last;
+   o << " [" << name(shown_) << ' ' << l[edit] / 1000 << '+' <<
+        l[show] / 1000 << '+' << l[write] / 1000 << "us]";
+}
+
+// one line a command: how many, then p50, p99 and max of each kind;
+// times in microseconds
+void
+Latency::dump()
+{
+   if (file_.empty()) return;
+   FILE *f = fopen(file_.c_str(), "w");
+   if (!f) { perror(file_.c_str()); return; }
+
+   static const char *kind[] = { "edit", "show", "write", "bytes" };
+   fprintf(f, "%-8s %7s", "key", "count");
+   for (auto k : kind)
+      fprintf(f, " %5s_p50 %5s_p99 %5s_max", k, k, k);
+   fputc('\n', f);
+   for (auto &i : commands_) {
+      Command &c = i.second;
+      fprintf(f, "%-8s %7ld", name(i.first).c_str(),
+              std::max(c.h[edit].count(), c.h[show].count()));
+      for (int k = 0; k < kinds; k++) {
+         const double d = k == bytes ? 1 : 1000;
+         fprintf(f, " %9.1f %9.1f %9.1f", c.h[k].quantile(.5) / d,
+                 c.h[k].quantile(.99) / d, c.h[k].max() / d); }
+      fputc('\n', f); }
+   if (fclose(f) == EOF) perror(file_.c_str());
+}
+
+// as the README has them: ^n, m-f; printable chars are all "insert"
+std::string
+Latency::name(int key)
+{
+   if (key < 0) return "redraw";
+   if (key == 0x100) return "paste";
+   std::string s = key & meta ? "m-" : "";
+   const int c = key & 0xff;
+   if (c >= ' ' && c < 0x7f) return key & meta ? s + char(c) : "insert";
+   if (c == 0x7f) return s + "^?";
+   if (c < ' ') return s + '^' + char(c >= 1 && c <= 26 ? c + '`' : c + '@');
+   char b[8];
+   snprintf(b, sizeof b, "0x%02x", c);
+   return s + b;
+}
+
+} // namespace
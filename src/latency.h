@@ -0,0 +1,64 @@
+#ifndef latency_h
+#define latency_h
+
+#include <map>
+#include <string>
+#include <vector>
+#include <iosfwd>
+
+namespace e {
+
+// Where a keystroke's time goes: for each command key, the View method it
+// ran, then the frame after it -- show(), the write to the terminal and
+// the bytes sent.  Samples go into log-linear histograms (8 buckets a
+// power of two, so within 12.5%), dumped as p50/p99/max on exit.
+class Latency {
+public:
+   enum { edit, show, write, bytes, kinds };
+   enum { meta = 0x1000 };                  // key came after ESC
+
+   static long now();                       // ns, monotonic
+
+   void start(const char *file, bool live); // file may be null
+   bool on()   { return on_; }
+   bool live() { return live_; }
+
+   void command(int key, long ns);          // key's View method took ns
+   void frame(long show_ns, long write_ns, long bytes);
+   void out(std::ostream &o);               // the last command, compactly
+   void dump();                             // to the file
+
+private:
+   class Hist {
+   public:
+      static const int sub = 3;             // log2 of buckets a power of two
+      void add(long v);
+      long quantile(double q);              // top of the bucket it is in
+      long count() { return count_; }
+      long max()   { return max_; }
+   private:
+      std::vector<unsigned> n_;
+      long count_ = 0, max_ = 0;
+      static int  bucket(long v);
+      static long top(int b);
+   };
+   struct Command {
+      Hist h[kinds];
+      long last[kinds] {};
+   };
+
+   bool on_ = false, live_ = false;
+   std::string file_;
+   std::map<int, Command> commands_;
+   int last_ = -1;          // key the next frame belongs to, -1 for none
+   bool framed_ = true;     // last_ has had its frame
+   int shown_ = -2;         // key of the last frame, -2 before the first
+
+   static std::string name(int key);
+};
+
+extern Latency latency;
+
+} // namespace
+
+#endif
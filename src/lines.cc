@@ -0,0 +1,369 @@
+#include <stdexcept>
+
+#include "lines.h"
+
+namespace e {
+
+namespace {
+
+unsigned
+prio_next()
+{
+   static unsigned x = 2463534242u;
+   x ^= x << 13;
+   x ^= x >> 17;
+   x ^= x << 5;
+   return x;
+}
+
+}
+
+Lines::~Lines()
+{
+   destroy(root_);
+}
+
+void
+Lines::destroy(Piece *p)
+{
+   if (!p) return;
+   destroy(p->l);
+   destroy(p->r);
+   delete p;
+}
+
+void
+Lines::update(Piece *p)
+{
+   p->lines = lines(p->l) + p->count + lines(p->r);
+   p->weight = weight(p->l) + p->own + weight(p->r);
+}
+
+Lines::Piece *
+Lines::make(bool add, int start, int count)
+{
+   return new Piece { add, start, count, count, 0, 0, prio_next(),
+                      nullptr, nullptr };
+}
+
+Lines::Piece *
+Lines::merge(Piece *a, Piece *b)
+{
+   if (!a) return b;
+   if (!b) return a;
+   if (a->prio > b->prio) {
+      a->r = merge(a->r, b);
+      update(a);
+      return a; }
+   b->l = merge(a, b->l);
+   update(b);
+   return b;
+}
+
+// a gets the first n lines of p, b the rest; a piece straddling the cut is
+// split in two
+void
+Lines::split(Piece *p, int n, Piece *&a, Piece *&b)
+{
+   if (!p) { a = b = nullptr; return; }
+
+   const int nl = lines(p->l);
+   if (n <= nl) {
+      split(p->l, n, a, p->l);
+      update(p);
+      b = p;
+      return; }
+   if (n >= nl + p->count) {
+      split(p->r, n - nl - p->count, p->r, b);
+      update(p);
+      a = p;
+      return; }
+
+   const int k = n - nl;
+   Piece *q = make(p->add, p->start + k, p->count - k);
+   q->own = weights(p).sum(q->start, q->count);
+   p->own -= q->own;
+   q->r = p->r;
+   update(q);
+   p->count = k;
+   p->r = nullptr;
+   update(p);
+   a = p;
+   b = q;
+}
+
+int
+Lines::size()
+{
+   return lines(root_);
+}
+
+// the piece holding line n; n becomes the offset into it
+Lines::Piece *
+Lines::locate(int &n)
+{
+   for (Piece *p = root_; p; ) {
+      const int nl = lines(p->l);
+      if (n < nl) { p = p->l; continue; }
+      n -= nl;
+      if (n < p->count) return p;
+      n -= p->count;
+      p = p->r; }
+   throw std::out_of_range("Lines::at");
+}
+
+Span &
+Lines::at(int n)
+{
+   Piece *p = locate(n);
+   return (p->add ? add_ : orig_).at(p->start + n);
+}
+
+void
+Lines::append(Span s)
+{
+   std::vector<Span> v { s };
+   append(v);
+}
+
+void
+Lines::append(std::vector<Span> &v)
+{
+   append(v.data(), v.size());
+}
+
+// load path: extend the last piece when it already ends at orig_'s tail
+void
+Lines::append(const Span *s, int n)
+{
+   if (!n) return;
+   const int start = orig_.size();
+   orig_.insert(orig_.end(), s, s + n);
+   orig_w_.push(n);
+
+   Piece *p = root_;
+   while (p && p->r) p = p->r;
+   if (p && !p->add && p->start + p->count == start) {
+      for (Piece *q = root_; q; q = q->r)
+         q->lines += n;
+      p->count += n;
+      return; }
+   root_ = merge(root_, make(false, start, n));
+}
+
+void
+Lines::reserve(int n)
+{
+   orig_.reserve(n);
+   orig_w_.t.reserve(n + 1);
+}
+
+void
+Lines::insert(int n, Span s)
+{
+   std::vector<Span> v { s };
+   insert(n, v);
+}
+
+void
+Lines::insert(int n, std::vector<Span> &v)
+{
+   if (v.empty()) return;
+   const int start = add_.size();
+   add_.insert(add_.end(), v.begin(), v.end());
+   add_w_.push(v.size());
+
+   Piece *a, *b;
+   split(root_, n, a, b);
+   root_ = merge(merge(a, make(true, start, v.size())), b);
+}
+
+Span
+Lines::erase(int n)
+{
+   if (n >= 0 && n < size()) set_weight(n, 0);
+
+   Piece *a, *m, *b;
+   split(root_, n, a, b);
+   split(b, 1, m, b);
+   Span s { nullptr, 0 };
+   if (m) std::swap(s, (m->add ? add_ : orig_).at(m->start));
+   destroy(m);
+   root_ = merge(a, b);
+   return s;
+}
+
+Span
+Lines::replace(int n, Span s)
+{
+   auto &i = at(n);
+   auto old = i;
+   i = s;
+   return old;
+}
+
+// moves pieces rather than slot contents, so a loaded slot only ever holds
+// its own line or an edit of it
+void
+Lines::swap(int n, int m)
+{
+   if (n > m) std::swap(n, m);
+   if (n == m || n < 0 || m >= size()) return;
+
+   Piece *a, *x, *mid, *y, *b;
+   split(root_, n, a, b);
+   split(b, 1, x, b);
+   split(b, m - n - 1, mid, b);
+   split(b, 1, y, b);
+   root_ = merge(merge(merge(merge(a, y), mid), x), b);
+}
+
+void
+Lines::each(const std::function<void (const Span &)> &f)
+{
+   each(root_, f);
+}
+
+void
+Lines::each(Piece *p, const std::function<void (const Span &)> &f)
+{
+   if (!p) return;
+   each(p->l, f);
+   auto &v = p->add ? add_ : orig_;
+   for (int i = 0; i < p->count; i++)
+      f(v[p->start + i]);
+   each(p->r, f);
+}
+
+int
+Lines::weight(int n)
+{
+   Piece *p = locate(n);
+   return weights(p).sum(p->start + n, 1);
+}
+
+void
+Lines::set_weight(int n, int w)
+{
+   int k = n;
+   Piece *t = locate(k);
+   const int d = w - weights(t).sum(t->start + k, 1);
+   if (!d) return;
+   weights(t).add(t->start + k, d);
+   t->own += d;
+   for (Piece *p = root_; ; ) {
+      p->weight += d;
+      if (p == t) break;
+      const int nl = lines(p->l);
+      if (n < nl) { p = p->l; continue; }
+      n -= nl + p->count;
+      p = p->r; }
+}
+
+int
+Lines::weight_before(int n)
+{
+   int w = 0;
+   for (Piece *p = root_; p; ) {
+      const int nl = lines(p->l);
+      if (n < nl) { p = p->l; continue; }
+      w += weight(p->l);
+      n -= nl;
+      if (n < p->count)
+         return w + weights(p).sum(p->start, n);
+      w += p->own;
+      n -= p->count;
+      p = p->r; }
+   return w;
+}
+
+int
+Lines::find_weight(int k)
+{
+   if (k < 0) return -1;
+   int n = 0;
+   for (Piece *p = root_; p; ) {
+      if (k < weight(p->l)) { p = p->l; continue; }
+      k -= weight(p->l);
+      n += lines(p->l);
+      if (k < p->own) {
+         auto &f = weights(p);
+         return n + f.find(k + f.sum(p->start)) - p->start; }
+      k -= p->own;
+      n += p->count;
+      p = p->r; }
+   return -1;
+}
+
+void
+Lines::clear_weights()
+{
+   orig_w_.t.assign(orig_w_.t.size(), 0);
+   add_w_.t.assign(add_w_.t.size(), 0);
+   update_weights(root_);
+}
+
+void
+Lines::set_loaded_weight(int i, const char *s, int w)
+{
+   if (i >= (int)orig_.size() || orig_[i].s != s) return;
+   orig_w_.add(i, w - orig_w_.sum(i, 1));
+}
+
+void
+Lines::update_weights()
+{
+   update_weights(root_);
+}
+
+void
+Lines::update_weights(Piece *p)
+{
+   if (!p) return;
+   update_weights(p->l);
+   update_weights(p->r);
+   p->own = weights(p).sum(p->start, p->count);
+   update(p);
+}
+
+// node i sums slots (i - lowbit(i), i]; of the new ones only those
+// reaching back past the old end have anything in them
+void
+Lines::Fenwick::push(int k)
+{
+   const int n = size(), total = sum(n);
+   t.resize(n + 1 + k);
+   for (int i = n + 1; i <= n + k; i++)
+      if (i - (i & -i) < n) t[i] = total - sum(i - (i & -i));
+}
+
+void
+Lines::Fenwick::add(int i, int d)
+{
+   for (i++; i < (int)t.size(); i += i & -i)
+      t[i] += d;
+}
+
+int
+Lines::Fenwick::sum(int n)
+{
+   int s = 0;
+   for (; n > 0; n -= n & -n)
+      s += t[n];
+   return s;
+}
+
+// smallest slot whose running sum exceeds k
+int
+Lines::Fenwick::find(int k)
+{
+   int i = 0, step = 1;
+   while (step * 2 <= size()) step *= 2;
+   for (; step; step /= 2)
+      if (i + step <= size() && t[i + step] <= k) {
+         i += step;
+         k -= t[i]; }
+   return i;
+}
+
+} // namespace
@@ -0,0 +1,92 @@
+#ifndef lines_h
+#define lines_h
+
+#include <vector>
+#include <functional>
+
+#include "span.h"
+
+namespace e {
+
+// Piece table of lines.  Loaded lines are appended to orig_, inserted ones
+// to add_; the document is a sequence of pieces (runs of consecutive slots
+// of either array) kept in an implicit treap, so lookup, insert and delete
+// by line number are O(log pieces).  A slot belongs to at most one piece,
+// so replacing a line just rewrites its slot.
+//
+// Every line also carries a non-negative weight (the keyword index keeps
+// hit counts there).  Slot weights live in a Fenwick tree per array and
+// pieces sum them, so weights can be summed up to a line, or a line found
+// by running weight, in O(log n).
+class Lines {
+public:
+   Lines() : root_(nullptr) { }
+   ~Lines();
+   Lines(const Lines &) = delete;
+   Lines &operator=(const Lines &) = delete;
+
+   int  size();
+   int  loaded() { return orig_.size(); }   // lines appended so far
+   void append(Span s);
+   void append(std::vector<Span> &v);
+   void append(const Span *s, int n);
+   void reserve(int n);               // loaded lines to come
+   Span &at(int n);
+   void insert(int n, Span s);
+   void insert(int n, std::vector<Span> &v);   // as one piece
+   Span erase(int n);                 // returns the line removed
+   Span replace(int n, Span s);       // returns the line replaced
+   void swap(int n, int m);
+   void each(const std::function<void (const Span &)> &f);
+
+   int  weight(int n);
+   void set_weight(int n, int w);
+   int  weight_before(int n);         // sum over lines [0, n)
+   int  weight_total() { return weight(root_); }
+   int  find_weight(int k);           // line holding unit k, or -1
+   void clear_weights();
+   // bulk path: loaded slot i gets weight w only if it still holds s;
+   // call update_weights() once done
+   void set_loaded_weight(int i, const char *s, int w);
+   void update_weights();
+
+private:
+   struct Piece {
+      bool   add;
+      int    start, count;
+      int    lines;        // subtree total
+      int    own, weight;  // own slots' weight, subtree total
+      unsigned prio;
+      Piece *l, *r;
+   };
+
+   struct Fenwick {
+      std::vector<int> t { 0 };        // 1-based
+      int  size() { return t.size() - 1; }
+      void push(int k);                // k slots of weight 0
+      void add(int i, int d);
+      int  sum(int n);                 // slots [0, n)
+      int  sum(int i, int n) { return sum(i + n) - sum(i); }
+      int  find(int k);
+   };
+
+   std::vector<Span> orig_, add_;
+   Fenwick orig_w_, add_w_;
+   Piece *root_;
+
+   static int  lines(Piece *p) { return p ? p->lines : 0; }
+   static int  weight(Piece *p) { return p ? p->weight : 0; }
+   Fenwick &weights(Piece *p) { return p->add ? add_w_ : orig_w_; }
+   Piece *locate(int &n);
+   void update_weights(Piece *p);
+   static void update(Piece *p);
+   static void destroy(Piece *p);
+   Piece *make(bool add, int start, int count);
+   Piece *merge(Piece *a, Piece *b);
+   void   split(Piece *p, int n, Piece *&a, Piece *&b);
+   void each(Piece *p, const std::function<void (const Span &)> &f);
+};
+
+} // namespace
+
+#endif
@@ -0,0 +1,90 @@
+#include <poll.h>
+#include <time.h>
+#include <cerrno>
+#include <algorithm>
+
+#include "loop.h"
+
+namespace e {
+
+long
+Loop::now()
+{
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return t.tv_sec * 1000L + t.tv_nsec / 1000000;
+}
+
+void
+Loop::watch(int fd, std::function<void ()> f, std::function<bool ()> more)
+{
+   unwatch(fd);
+   watches_.push_back(Watch { fd, f, more });
+}
+
+void
+Loop::unwatch(int fd)
+{
+   watches_.erase(std::remove_if(watches_.begin(), watches_.end(),
+         [fd](const Watch &w) { return w.fd == fd; }), watches_.end());
+}
+
+int
+Loop::after(long ms, std::function<void ()> f)
+{
+   timers_.push_back(Timer { next_id_, now() + ms, f });
+   return next_id_++;
+}
+
+void
+Loop::cancel(int id)
+{
+   timers_.erase(std::remove_if(timers_.begin(), timers_.end(),
+         [id](const Timer &t) { return t.id == id; }), timers_.end());
+}
+
+// callbacks may watch, unwatch, add or cancel timers, so each one is
+// looked up again before it runs.  A watch with more to do does not wait
+// for its fd, which poll() would not see as readable again.
+void
+Loop::run()
+{
+   quit_ = false;
+   while (!quit_) {
+      long t = now(), wait = -1;
+      for (auto &i : timers_)
+         if (wait < 0 || i.at - t < wait) wait = std::max(0L, i.at - t);
+
+      std::vector<struct pollfd> p;
+      std::vector<bool> more;
+      for (auto &w : watches_) {
+         p.push_back(pollfd { w.fd, POLLIN, 0 });
+         more.push_back(w.more && w.more());
+         if (more.back()) wait = 0; }
+      if (poll(p.data(), p.size(), wait) == -1 && errno != EINTR) return;
+
+      t = now();
+      std::vector<int> due;
+      for (auto &i : timers_)
+         if (i.at <= t) due.push_back(i.id);
+      for (int id : due) {
+         auto i = std::find_if(timers_.begin(), timers_.end(),
+               [id](const Timer &t) { return t.id == id; });
+         if (i == timers_.end()) continue;
+         auto f = i->f;
+         timers_.erase(i);
+         f();
+         if (quit_) return; }
+
+      for (size_t j = 0; j < p.size(); j++) {
+         const pollfd &i = p[j];
+         if (!i.revents && !more[j]) continue;
+         auto w = std::find_if(watches_.begin(), watches_.end(),
+               [&i](const Watch &w) { return w.fd == i.fd; });
+         if (w == watches_.end()) continue;
+         auto f = w->f;
+         f();
+         if (quit_) return; } }
+}
+
+} // namespace
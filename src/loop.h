@@ -0,0 +1,39 @@
+#ifndef loop_h
+#define loop_h
+
+#include <functional>
+#include <vector>
+
+namespace e {
+
+// poll(2) over file descriptors, plus one-shot timers.  Callbacks run on
+// the thread that calls run(), one at a time.
+class Loop {
+public:
+   static long now();                                // ms, monotonic
+
+   // f when fd is readable, or more() says f has input it read already
+   void watch(int fd, std::function<void ()> f,
+              std::function<bool ()> more = nullptr);
+   void unwatch(int fd);
+   int  after(long ms, std::function<void ()> f);    // returns a timer id
+   void cancel(int id);
+   void run();                                       // until quit()
+   void quit() { quit_ = true; }
+
+private:
+   struct Watch {
+      int fd;
+      std::function<void ()> f;
+      std::function<bool ()> more; };
+   struct Timer { int id; long at; std::function<void ()> f; };
+
+   std::vector<Watch> watches_;
+   std::vector<Timer> timers_;
+   int  next_id_ = 0;
+   bool quit_ = false;
+};
+
+} // namespace
+
+#endif
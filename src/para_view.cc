@@ -1,11 +1,11 @@
 #include <iostream>
-#define COLOUR_ESC "\033"
-#define COLOUR_RED     COLOUR_ESC "[31m"
-#define COLOUR_CYAN    COLOUR_ESC "[36m"
-#define COLOUR_GREY    COLOUR_ESC "[38;5;248m"
-#define COLOUR_NORMAL  COLOUR_ESC "[0m"
-#define COLOUR_GREY_BG COLOUR_ESC "[48;5;248m"
+#define COLOUR_RED     Attr { Attr::fg, 1 }
+#define COLOUR_CYAN    Attr { Attr::fg, 6 }
+#define COLOUR_GREY    Attr { Attr::fg, 248 }
+#define COLOUR_NORMAL  Attr { Attr::normal }
+#define COLOUR_GREY_BG Attr { Attr::bg, 248 }
 
+#include "screen.h"
 #include "str.h"
 #include "buf.h"
 #include "view.h"
@@ -40,8 +40,8 @@ ParaView::show()
 
    int n = 0;
    for (int i = window_offset_; i < buf_->num_of_lines(); i++) {
-      if (i == 0 || (!*buf_->get_line(i - 1) &&
-                      *buf_->get_line(i))) {
+      if (i == 0 || (!buf_->get_line(i - 1).size &&
+                      buf_->get_line(i).size)) {
          lnum_padding_out(lnum_col(buf_->num_of_lines()) - lnum_col(i));
          std::cout << COLOUR_GREY << i << ": " << COLOUR_NORMAL;
          if (n == cursor_row_) std::cout << COLOUR_GREY_BG;
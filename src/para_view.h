@@ -47,6 +47,7 @@ public:
    virtual void new_line() { }
    virtual void insert_new_line(bool left) { }
    virtual void char_insert(char c) { }
+   virtual void paste(const char *s, int size) { }
    virtual void char_delete_forward() { }
    virtual void char_delete_backward() { }
    virtual void char_delete_to_eol() { }
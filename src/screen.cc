@@ -0,0 +1,212 @@
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+
+#include "screen.h"
+
+extern "C" {
+   const char *tc_str(const char *);
+   const char *tc_goto(int, int);
+   const char *tc_fg(int);
+   const char *tc_bg(int);
+}
+
+namespace e {
+
+Screen screen;
+
+const char *
+Attr::str() const
+{
+   return what == fg ? tc_fg(colour) : what == bg ? tc_bg(colour) :
+          tc_str("me");
+}
+
+std::ostream &
+operator<<(std::ostream &o, const Attr &a)
+{
+   if (auto s = dynamic_cast<Screen *>(o.rdbuf()))
+      s->attr(a);
+   else
+      o << a.str();
+   return o;
+}
+
+bool
+Screen::Cell::operator==(const Cell &c) const
+{
+   return n == c.n && fg == c.fg && bg == c.bg && !memcmp(s, c.s, n);
+}
+
+void
+Screen::begin()
+{
+   next_.assign(1, Row());
+   fg_ = bg_ = -1;
+   saved_ = std::cout.rdbuf(this);
+}
+
+void
+Screen::clear()
+{
+   clear_ = true;
+}
+
+void
+Screen::size(int &cols, int &rows)
+{
+   if (vcols_ > 0) {
+      cols = vcols_;
+      rows = vrows_;
+      return; }
+
+   struct winsize w;
+
+   /* see tty_ioctl(4) */
+   ioctl(STDIN_FILENO, TIOCGWINSZ, &w);
+   cols = w.ws_col;
+   rows = w.ws_row;
+}
+
+void
+Screen::attr(const Attr &a)
+{
+   stats_.full_bytes += strlen(a.str());
+   switch (a.what) {
+   case Attr::normal: fg_ = bg_ = -1; break;
+   case Attr::fg:     fg_ = a.colour; break;
+   case Attr::bg:     bg_ = a.colour; break; }
+}
+
+void
+Screen::end()
+{
+   std::cout.rdbuf(saved_);
+   if (next_.back().empty()) next_.pop_back();
+
+   out_.clear();
+   if (clear_) {
+      out_ += tc_str("cl");
+      rows_.clear();
+      clear_ = false; }
+
+   for (int y = 0; y < (int)next_.size(); y++)
+      paint(y, y < (int)rows_.size() ? &rows_[y] : nullptr, next_[y]);
+   if (next_.size() < rows_.size()) {
+      sgr(-1, -1);
+      out_ += tc_goto(0, next_.size());
+      out_ += tc_str("cd"); }
+   sgr(-1, -1);
+   rows_.swap(next_);
+
+   flush();
+   stats_.frames++;
+   stats_.bytes   += out_.size();
+   stats_.escapes += std::count(out_.begin(), out_.end(), '\033');
+}
+
+// Only the cells from the first to the last that changed.  cm counts
+// columns, so that needs every cell either side to be one column wide;
+// otherwise the row is cleared and written out whole.
+void
+Screen::paint(int y, const Row *old, const Row &row)
+{
+   if (old && *old == row) return;
+
+   int x = 0, end = row.size();
+   bool plain = old != nullptr;
+   for (int i = 0; plain && i < (int)old->size(); i++) plain = (*old)[i].plain();
+   for (int i = 0; plain && i < end; i++) plain = row[i].plain();
+
+   if (plain) {
+      while (x < end && x < (int)old->size() && row[x] == (*old)[x]) x++;
+      if (old->size() == row.size())
+         while (end > x && row[end - 1] == (*old)[end - 1]) end--;
+      out_ += tc_goto(x, y); }
+   else {
+      out_ += tc_goto(0, y);
+      if (old && !old->empty()) {
+         sgr(-1, -1);
+         out_ += tc_str("ce"); } }
+
+   // a blank shows no foreground, so it takes whatever is set
+   for (int i = x; i < end; i++) {
+      const Cell &c = row[i];
+      if (c.n != 1 || c.s[0] != ' ' || c.bg != tbg_) sgr(c.fg, c.bg);
+      out_.append(c.s, c.n); }
+
+   // a full row leaves the cursor in the last column, where ce would
+   // clear it; a shorter one never gets there
+   if (plain && old->size() > row.size()) {
+      sgr(-1, -1);
+      out_ += tc_str("ce"); }
+}
+
+// the fewest escapes from what the terminal has to fg and bg
+void
+Screen::sgr(short fg, short bg)
+{
+   if (fg == tfg_ && bg == tbg_) return;
+   if ((fg < 0 && tfg_ >= 0) || (bg < 0 && tbg_ >= 0)) {
+      out_ += tc_str("me");
+      tfg_ = tbg_ = -1; }
+   if (fg != tfg_) out_ += tc_fg(fg);
+   if (bg != tbg_) out_ += tc_bg(bg);
+   tfg_ = fg;
+   tbg_ = bg;
+}
+
+// stdio may still hold ti and the like, which go first
+void
+Screen::flush()
+{
+   fflush(stdout);
+
+   long n = 0;
+   for (size_t i = 0; i < out_.size(); ) {
+      ssize_t r = write(fd_, &out_[i], out_.size() - i);
+      n++;
+      if (r < 0 && errno == EINTR) continue;
+      if (r <= 0) { stats_.write_errors++; break; }
+      i += r; }
+   stats_.writes += n;
+   if (n > stats_.max_writes) stats_.max_writes = n;
+}
+
+int
+Screen::overflow(int c)
+{
+   if (c != traits_type::eof()) put(c);
+   return c;
+}
+
+std::streamsize
+Screen::xsputn(const char *s, std::streamsize n)
+{
+   for (std::streamsize i = 0; i < n; i++)
+      put(s[i]);
+   return n;
+}
+
+// continuation bytes join the char their lead byte started
+void
+Screen::put(char c)
+{
+   stats_.full_bytes++;
+   if (c == '\n') { next_.emplace_back(); return; }
+
+   Row &r = next_.back();
+   const unsigned char u = c;
+   if ((u & 0xc0) == 0x80 && !r.empty()) {
+      Cell &l = r.back();
+      const unsigned char l0 = l.s[0];
+      const int size = l0 >= 0xf0 ? 4 : l0 >= 0xe0 ? 3 : l0 >= 0xc0 ? 2 : 1;
+      if (l.n < size) { l.s[l.n++] = c; return; } }
+   r.push_back(Cell { { c }, 1, fg_, bg_ });
+}
+
+} // namespace
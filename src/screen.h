@@ -0,0 +1,85 @@
+#ifndef screen_h
+#define screen_h
+
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace e {
+
+struct ScreenStats {
+   long frames;
+   long bytes;        // sent to the terminal
+   long escapes;      // ESC bytes among them
+   long full_bytes;   // what the views wrote, escapes and all
+   long writes;       // write(2) calls
+   long max_writes;   // most in one frame
+   long write_errors; // frames cut short by a failed write
+};
+
+// A change of attributes for what is written after it: a colour (0..255)
+// for the foreground or background, or back to normal.  Into a Screen it
+// sets the attributes of the cells that follow; anywhere else it is
+// written as the SGR sequence.
+struct Attr {
+   enum { normal, fg, bg } what;
+   int colour;
+   const char *str() const;
+};
+
+std::ostream &operator<<(std::ostream &o, const Attr &a);
+
+// What is on the terminal, cell by cell.  A frame is still rendered through
+// std::cout, but into here, each char becoming a cell with the attributes
+// in effect.  end() compares the cells with the last frame's and sends,
+// in a single write(2), just the runs that changed, addressed with cm,
+// changing attributes only where they differ from the terminal's.
+class Screen : public std::streambuf {
+public:
+   Screen() : saved_(nullptr), clear_(true) { }
+   void begin();      // capture std::cout
+   void end();        // stop and update the terminal
+   void clear();      // repaint everything next time
+
+   // headless: a virtual terminal of cols x rows (0 x 0 for the tty), and
+   // where frames go
+   void set_size(int cols, int rows) { vcols_ = cols; vrows_ = rows; }
+   void size(int &cols, int &rows);
+   void set_output(int fd) { fd_ = fd; }
+   void attr(const Attr &a);
+   const ScreenStats &stats() { return stats_; }
+
+private:
+   struct Cell {
+      char  s[4];     // a char, up to 4 bytes of UTF-8
+      short n;
+      short fg, bg;   // -1 for the default
+      bool operator==(const Cell &c) const;
+      bool plain() const { return n == 1 && s[0] >= ' ' && s[0] < 0x7f; }
+   };
+   typedef std::vector<Cell> Row;
+
+   std::vector<Row> rows_, next_;
+   short fg_ = -1, bg_ = -1;     // for the cells being captured
+   short tfg_ = -1, tbg_ = -1;   // on the terminal
+   std::string out_;
+   std::streambuf *saved_;
+   bool clear_;
+   int  vcols_ = 0, vrows_ = 0;
+   int  fd_ = 1;
+   ScreenStats stats_ {};
+
+   int overflow(int c) override;
+   std::streamsize xsputn(const char *s, std::streamsize n) override;
+   void put(char c);
+   void paint(int y, const Row *old, const Row &row);
+   void sgr(short fg, short bg);
+   void flush();
+};
+
+extern Screen screen;
+
+} // namespace
+
+#endif
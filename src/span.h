@@ -0,0 +1,22 @@
+#ifndef span_h
+#define span_h
+
+namespace e {
+
+// A line: bytes (not NUL-terminated, may contain NUL) and, once measured,
+// its length in chars and what kind of text it is.
+struct Span {
+   enum { ascii = 1, utf8 = 2 }; // flags: all bytes < 0x80, valid UTF-8
+
+   const char *s;
+   int size;       // bytes
+   int len = -1;   // chars, -1 until measured
+   int flags = 0;
+   // long non-ASCII lines: byte offset of every Str::mark_step-th char,
+   // owned by Buf and gone when the line changes
+   const int *marks = nullptr;
+};
+
+} // namespace
+
+#endif
@@ -1,7 +1,9 @@
 #include <iostream>
 #include <cstring>
 #include <cctype>
+#include "keywords.h"
 #include "str.h"
+#include "utf8.h"
 
 namespace e {
 
@@ -15,15 +17,18 @@ Str::char_size(const char *c)
 }
 
 int
-Str::operator[](int index)
+Str::decode(int x)
 {
-   auto s = &s_[index_chars_to_bytes(index)];
+   if (x >= size_) return 0;
+   if (ascii_) return s_[x];
+   auto s = &s_[x];
    int l, r;
 
    switch (l = char_size(s)) {
    case 0:
       return *s;
    case 2 ... 6:
+      if (x + l > size_) return -1;
       r = (0x7f >> l) & *s;
       for (int i = 1; i < l; i++)
          r = (r << 6) | (s[i] & 0x3f);
@@ -32,95 +37,152 @@ Str::operator[](int index)
       return -1; }
 }
 
+Str::Iter &
+Str::Iter::operator++()
+{
+   if (++n_ == 0)
+      b_ = s_->index_chars_to_bytes(0);
+   else if (b_ < s_->size_) {
+      if (s_->ascii_) b_++;
+      else do b_++; while (b_ < s_->size_ && !s_->lead(b_)); }
+   return *this;
+}
+
+Str::Iter &
+Str::Iter::operator--()
+{
+   if (--n_ < 0 || n_ >= s_->len())
+      b_ = s_->size_;
+   else if (s_->ascii_)
+      b_ = n_;
+   else
+      do b_--; while (b_ > 0 && !s_->lead(b_));
+   return *this;
+}
+
+void
+Str::Iter::output()
+{
+   if (b_ >= s_->size_) return;
+   int l = s_->ascii_ ? 1 : s_->char_size(&s_->s_[b_]);
+   if (l < 1 || b_ + l > s_->size_) l = 1;
+   std::cout.write(&s_->s_[b_], l);
+}
+
 int
 Str::len()
 {
-   int l = 0;
-   for (const char *i = s_; *i; i++)
-      if ((*i & 0xc0) != 0x80) l++;
-   return l;
+   if (len_ >= 0) return len_;
+   return len_ = ascii_ ? size_ : utf8_count(s_, size_);
 }
 
 int
 Str::index_chars_to_bytes(int n)
 {
-   int l = 0;
-   for (const char *i = s_; *i; i++)
-      if ((*i & 0xc0) != 0x80 && l++ == n)
-         return i - s_;
-   return size();
+   if (ascii_) return n >= 0 && n < size_ ? n : size_;
+   if (marks_ && n >= mark_step && n < len()) {
+      const int b = marks_[n / mark_step];
+      return b + utf8_offset(s_ + b, size_ - b, n % mark_step); }
+   return utf8_offset(s_, size_, n);
 }
 
 int
 Str::index_bytes_to_chars(int n)
 {
-   int l = 0;
-   const char *i = s_;
-   for (; n; i++, n--)
-      if ((*i & 0xc0) != 0x80) l++;
-   return l;
+   if (n > size_) n = size_;
+   if (ascii_) return n;
+   if (marks_ && n > 0) {
+      // last mark at or before byte n
+      int lo = 0, hi = len() / mark_step;
+      while (lo < hi) {
+         int mid = (lo + hi + 1) / 2;
+         if (marks_[mid] <= n) lo = mid; else hi = mid - 1; }
+      return lo * mark_step + utf8_count(s_ + marks_[lo], n - marks_[lo]); }
+   return utf8_count(s_, n);
 }
 
+// first keyword at or after char pos, -1 if none
 int
-my_strncmp(const char *s0, const char *s1, int n)
+Str::search_word(Keywords &ws, int pos=0)
 {
-   int r = strncmp(s0, s1, n);
-   return r ?: s1[n];
+   int b = ws.find(Span { s_, size_ }, index_chars_to_bytes(pos));
+   return b < 0 ? -1 : index_bytes_to_chars(b);
 }
 
+// the last keyword starting before char pos
 int
-Str::search_word(std::vector<const char *> &ws, int pos=0)
+Str::search_word_prev(Keywords &ws, int pos)
 {
-   const char *s0 = nullptr; // word
-   const char *s1 = s_;      // BOL
-   const char *s2 = s1;      // search starting pos
-
-   if (pos) {
-      int d = index_chars_to_bytes(pos);
-      if (d > size()) return -1;
-      s2 += d; }
-
-   for (auto j = s2; *j; j++) {
-      if (!s0 && isalpha(*j)) s0 = j;
-      if (s0 && !isalpha(*j)) {
-         for (auto w : ws)
-            if (my_strncmp(s0, w, j - s0) == 0)
-               return index_bytes_to_chars(s0 - s1);
-         s0 = nullptr; } }
-   if (s0)
-      for (auto w : ws)
-         if (strcmp(s0, w) == 0)
-            return index_bytes_to_chars(s0 - s1);
-   return -1;
+   int b = ws.rfind(Span { s_, size_ }, index_chars_to_bytes(pos));
+   return b < 0 ? -1 : index_bytes_to_chars(b);
 }
 
+// the keyword at char pos, if any
 const char *
-Str::match_word(std::vector<const char *> &ws, int pos=0)
+Str::match_word(Keywords &ws, int pos=0)
 {
-   const char *s = s_;
-
-   if (pos) {
-      int d = index_chars_to_bytes(pos);
-      if (d > size()) return nullptr;
-      s += d; }
+   return ws.match(Span { s_, size_ }, index_chars_to_bytes(pos));
+}
 
-   const char *j;
-   for (j = s; *j && isalpha(*j); j++) ;
+void
+Str::output_char(int n)
+{
+   at(n).output();
+}
 
-   for (auto w : ws)
-      if (my_strncmp(s, w, j - s) == 0)
-         return w;
+void
+measure(Span &l)
+{
+   auto s = (const unsigned char *)l.s;
+   int len = 0, ascii = 1, utf8 = 1;
+
+   for (int i = 0; i < l.size; ) {
+      unsigned c = s[i];
+      len++;
+      if (c < 0x80) { i++; continue; }
+      ascii = 0;
+
+      // lead byte: sequence length and the least value it may encode
+      int n; unsigned min;
+      if      (c >= 0xc2 && c <= 0xdf) { n = 2; min = 0x80; }
+      else if (c >= 0xe0 && c <= 0xef) { n = 3; min = 0x800; }
+      else if (c >= 0xf0 && c <= 0xf4) { n = 4; min = 0x10000; }
+      else {
+         if ((c & 0xc0) == 0x80) len--; // stray continuation byte
+         utf8 = 0; i++; continue; }
+
+      // chars are counted as everywhere else, by non-continuation bytes,
+      // so a sequence runs to the next of those whatever n says
+      unsigned r = c & (0x7f >> n);
+      int k = 1;
+      for (; i + k < l.size && (s[i + k] & 0xc0) == 0x80; k++)
+         r = (r << 6) | (s[i + k] & 0x3f);
+      if (k != n || r < min || r > 0x10ffff || (r >= 0xd800 && r <= 0xdfff))
+         utf8 = 0;
+      i += k; }
+
+   l.len   = len;
+   l.flags = (ascii ? Span::ascii : 0) | (utf8 ? Span::utf8 : 0);
+}
 
-   return nullptr;
+const int *
+mark(Span l)
+{
+   if ((l.flags & Span::ascii) || l.size < Str::mark_min) return nullptr;
+
+   const int n = l.len / Str::mark_step + 1;
+   int *m = new int[n];
+   m[0] = utf8_offset(l.s, l.size, 0);
+   for (int i = 1; i < n; i++)
+      m[i] = m[i - 1] + utf8_offset(l.s + m[i - 1], l.size - m[i - 1],
+                                    Str::mark_step);
+   return m;
 }
 
-void
-Str::output_char(int n)
+std::ostream &
+operator<<(std::ostream &o, Span l)
 {
-   int x = index_chars_to_bytes(n);
-   int l = char_size(&s_[x]) ?: 1;
-   for (int i = 0; i < l; i++)
-      std::cout << s_[x + i];
+   return o.write(l.s, l.size);
 }
 
 } // namespace
@@ -3,25 +3,66 @@
 
 #include <vector>
 #include <cstring>
+#include <iosfwd>
+
+#include "span.h"
 
 namespace e {
 
+class Keywords;
+
 class Str { // UTF-8 string
 public:
-   Str(const char *s) : s_(s) { }
-   int operator[](int index);
+   // A char position that remembers its byte offset, so walking a line
+   // costs one step per char instead of an index_chars_to_bytes() each.
+   class Iter {
+   public:
+      int   operator*() { return s_->decode(b_); } // as Str::operator[]
+      Iter &operator++();
+      Iter &operator--();
+      int   index() { return n_; } // chars
+      int   pos()   { return b_; } // bytes
+      void  output();              // as Str::output_char
+   private:
+      friend class Str;
+      Iter(Str *s, int n, int b) : s_(s), n_(n), b_(b) { }
+      Str *s_;
+      int  n_, b_;
+   };
+
+   static const int mark_step = 256;   // chars between marks
+   static const int mark_min  = 4096;  // bytes; shorter lines go unmarked
+
+   Str(const char *s) : s_(s), size_(strlen(s)), len_(-1), ascii_(false),
+                        marks_(nullptr) { }
+   Str(Span l) : s_(l.s), size_(l.size), len_(l.len),
+                 ascii_(l.flags & Span::ascii), marks_(l.marks) { }
+   int operator[](int index) { return decode(index_chars_to_bytes(index)); }
+   Iter at(int index) { return Iter(this, index, index_chars_to_bytes(index)); }
+   Iter at(int index, int pos) { return Iter(this, index, pos); } // pos known
    int len(); // chars
-   int size() { return strlen(s_); } // bytes
+   int size() { return size_; } // bytes
    int index_chars_to_bytes(int n);
    int index_bytes_to_chars(int n);
-   int search_word(std::vector<const char *> &ws, int pos);
-   const char *match_word(std::vector<const char *> &ws, int pos);
+   int search_word(Keywords &ws, int pos);
+   int search_word_prev(Keywords &ws, int pos);
+   const char *match_word(Keywords &ws, int pos);
    void output_char(int n);
 private:
    const char *s_;
-   static int char_size(const char *c);
+   int size_;
+   int len_;
+   bool ascii_; // chars are bytes
+   const int *marks_;
+   int char_size(const char *c);
+   int decode(int x); // char at byte x, 0 at the end, -1 if malformed
+   bool lead(int x) { return (s_[x] & 0xc0) != 0x80; }
 };
 
+void measure(Span &l); // fill in len and flags
+const int *mark(Span l); // checkpoints for Span::marks, nullptr if not worth it
+std::ostream &operator<<(std::ostream &o, Span l);
+
 } // namespace
 
 #endif
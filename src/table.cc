@@ -0,0 +1,385 @@
+#include <cstring>
+#include <cmath>
+#include <charconv>
+#include <algorithm>
+#include <numeric>
+#include <thread>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "buf.h"
+#include "table.h"
+
+namespace e {
+
+namespace {
+
+// small columns are not worth a thread
+int
+threads(long n)
+{
+   const int t = std::thread::hardware_concurrency();
+   return n < (1 << 16) || t < 1 ? 1 : std::min(t, 64);
+}
+
+// f(0) .. f(t - 1), each on a thread of its own (f(0) on this one)
+template <class F> void
+on_threads(int t, F f)
+{
+   std::vector<std::thread> ts;
+   for (int i = 1; i < t; i++) ts.emplace_back(f, i);
+   f(0);
+   for (auto &i : ts) i.join();
+}
+
+long slice(long n, int s, int t) { return n * s / t; }
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+// eight ASCII digits in a word, and what they come to, a word at a time
+inline bool
+eight_digits(unsigned long w)
+{
+   return ((w & 0xf0f0f0f0f0f0f0f0) |
+           ((w + 0x0606060606060606) & 0xf0f0f0f0f0f0f0f0) >> 4) ==
+          0x3333333333333333;
+}
+
+inline unsigned long
+eight_digits_value(unsigned long w)
+{
+   w = (w & 0x0f0f0f0f0f0f0f0f) * 2561 >> 8;
+   w = (w & 0x00ff00ff00ff00ff) * 6553601 >> 16;
+   return (w & 0x0000ffff0000ffff) * 42949672960001 >> 32;
+}
+#endif
+
+// the digits from p on, onto m; n counts them
+const char *
+digits(const char *p, const char *end, unsigned long &m, int &n)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+   unsigned long w;
+   while (end - p >= 8 && (memcpy(&w, p, 8), eight_digits(w))) {
+      m = m * 100000000 + eight_digits_value(w);
+      p += 8;
+      n += 8; }
+#endif
+   for (; p < end && unsigned(*p - '0') < 10; p++, n++)
+      m = m * 10 + (*p - '0');
+   return p;
+}
+
+// [-]digits[.digits], 15 digits at most: then the digits and the power of
+// ten are both exact in a double, and the one division rounds just as
+// from_chars() would.  False for anything else.
+bool
+quick_number(const char *s, const char *end, double &v)
+{
+   static const double tens[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7,
+                                  1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15 };
+   const bool minus = s < end && *s == '-';
+   unsigned long m = 0;
+   int n = 0, point = 0;
+   const char *p = digits(s + minus, end, m, n);
+   if (p < end && *p == '.') {
+      const char *q = digits(p + 1, end, m, n);
+      point = q - (p + 1);
+      p = q; }
+   if (p != end || !n || n > 15) return false;
+   v = m / tens[point];
+   if (minus) v = -v;
+   return true;
+}
+
+// the whole field, give or take spaces around it and a '+'; not "inf" or
+// "nan", which from_chars() takes too
+double
+number(Column::Cell c)
+{
+   const char *s = c.s, *end = c.s + c.size;
+   while (s < end && *s == ' ') s++;
+   while (end > s && end[-1] == ' ') end--;
+   if (s < end && *s == '+') s++;
+   double v;
+   if (quick_number(s, end, v)) return v;
+   auto r = std::from_chars(s, end, v);
+   return s < end && r.ec == std::errc() && r.ptr == end && std::isfinite(v) ?
+          v : NAN;
+}
+
+// compares as the bytes do, most of the time settling it
+unsigned long
+head(Column::Cell c)
+{
+   unsigned long h = 0;
+   for (int i = 0; i < 8; i++)
+      h = h << 8 | (i < c.size ? (unsigned char)c.s[i] : 0);
+   return h;
+}
+
+// v[0] .. v[n - 1] summed up, NaNs left out.  Two lanes of two doubles at
+// a time: a NaN is masked out of the sum, and min and max pass it over as
+// they give their second operand when either is one.
+Column::Stats
+reduce(const double *v, long n)
+{
+   Column::Stats st { 0, 0, INFINITY, -INFINITY };
+   long i = 0;
+#if defined(__SSE2__)
+   __m128d sum[2], lo[2], hi[2];
+   for (int j = 0; j < 2; j++) {
+      sum[j] = _mm_setzero_pd();
+      lo[j]  = _mm_set1_pd(INFINITY);
+      hi[j]  = _mm_set1_pd(-INFINITY); }
+   for (; n - i >= 4; i += 4)
+      for (int j = 0; j < 2; j++) {
+         const __m128d x = _mm_loadu_pd(v + i + 2 * j), ok = _mm_cmpord_pd(x, x);
+         sum[j] = _mm_add_pd(sum[j], _mm_and_pd(x, ok));
+         lo[j]  = _mm_min_pd(x, lo[j]);
+         hi[j]  = _mm_max_pd(x, hi[j]);
+         st.count += __builtin_popcount(_mm_movemask_pd(ok)); }
+   double s[2], l[2], h[2];
+   _mm_storeu_pd(s, _mm_add_pd(sum[0], sum[1]));
+   _mm_storeu_pd(l, _mm_min_pd(lo[0], lo[1]));
+   _mm_storeu_pd(h, _mm_max_pd(hi[0], hi[1]));
+   st.sum = s[0] + s[1];
+   st.min = std::min(l[0], l[1]);
+   st.max = std::max(h[0], h[1]);
+#endif
+   for (; i < n; i++)
+      if (!std::isnan(v[i])) {
+         st.count++;
+         st.sum += v[i];
+         st.min = std::min(st.min, v[i]);
+         st.max = std::max(st.max, v[i]); }
+   return st;
+}
+
+}
+
+Column::Cell
+Column::cell(Span l, const Fields &f, int k, Dsv d)
+{
+   if (k >= f.count()) return Cell { l.s + l.size, 0 };
+   Cell c { l.s + f.start_byte(k), f.end_byte(k, l) - f.start_byte(k) };
+   if (d.quoted && c.size >= 2 && c.s[0] == '"' && c.s[c.size - 1] == '"')
+      c = Cell { c.s + 1, c.size - 2 };
+   return c;
+}
+
+Column::Column(Buf &b) :
+   all_(true),
+   numeric_(false),
+   texts_(0),
+   cancel_(false)
+{
+   take(b);
+}
+
+Column::Column(Buf &b, std::vector<int> lines) :
+   all_(false),
+   lines_(std::move(lines)),
+   numeric_(false),
+   texts_(0),
+   cancel_(false)
+{
+   take(b);
+}
+
+void
+Column::take(Buf &b)
+{
+   const int n = all_ ? b.num_of_lines() : lines_.size();
+
+   // the line table is only ever read from this thread
+   cells_.resize(n);
+   size_t copied = 0;
+   for (int i = 0; i < n; i++) {
+      const Span l = b.raw_line(line(i));
+      cells_[i] = Cell { l.s, l.size };
+      if (!b.kept(l.s)) copied += l.size; }
+   if (!copied) return;
+
+   copies_.resize(copied);
+   char *p = copies_.data();
+   for (auto &c : cells_)
+      if (!b.kept(c.s)) {
+         memcpy(p, c.s, c.size);
+         c.s = p;
+         p += c.size; }
+}
+
+bool
+Column::cut(int k, Dsv d)
+{
+   const int n = size();
+   values_.resize(n);
+   heads_.resize(n);
+   const int t = threads(n);
+   std::vector<long> numbers(t), texts(t);
+   on_threads(t, [&](int s) {
+      Fields f;
+      for (long i = slice(n, s, t); i < slice(n, s + 1, t); i++) {
+         if (!(i & 4095) && cancel_) return;
+         const Span l { cells_[i].s, cells_[i].size };
+         split_fields(l, d, f);
+         Cell &c = cells_[i] = cell(l, f, k, d);
+         values_[i] = number(c);
+         heads_[i]  = head(c);
+         if (!std::isnan(values_[i])) numbers[s]++;
+         else if (c.size) texts[s]++; } });
+   texts_ = std::accumulate(texts.begin(), texts.end(), 0L);
+   numeric_ = std::accumulate(numbers.begin(), numbers.end(), 0L) > texts_;
+   return !cancel_;
+}
+
+Column::Value
+Column::value(Cell c)
+{
+   const double v = number(c);
+   return Value { v, std::isnan(v) && c.size > 0 };
+}
+
+// a slice a thread, then the slices' put together
+Column::Stats
+Column::stats()
+{
+   const int n = size(), t = threads(n);
+   std::vector<Stats> v(t);
+   on_threads(t, [&](int s) {
+      const long a = slice(n, s, t);
+      v[s] = reduce(values_.data() + a, slice(n, s + 1, t) - a); });
+   Stats st { 0, 0, INFINITY, -INFINITY };
+   for (auto &i : v) {
+      st.count += i.count;
+      st.sum += i.sum;
+      st.min = std::min(st.min, i.min);
+      st.max = std::max(st.max, i.max); }
+   return st;
+}
+
+std::vector<int>
+Column::sorted(bool descending)
+{
+   // what a field sorts by, in a row of its own so a comparison seldom
+   // looks further: its kind (number if the column is of them, other text,
+   // empty), then its value's bits or its first bytes, as unsigned
+   struct Key { unsigned long key; int kind, i; };
+   const int n = size(), t = threads(n);
+   std::vector<Key> v(n), w(n);
+   on_threads(t, [&](int s) {
+      for (long i = slice(n, s, t); i < slice(n, s + 1, t); i++) {
+         unsigned long k = heads_[i];
+         int kind = cells_[i].size ? 1 : 2;
+         if (numeric_ && !std::isnan(values_[i])) {
+            const double d = values_[i] ? values_[i] : 0.0;   // no -0
+            memcpy(&k, &d, sizeof k);
+            k = k >> 63 ? ~k : k | 1UL << 63;
+            kind = 0; }
+         v[i] = Key { descending ? ~k : k, kind, int(i) }; } });
+
+   auto less = [&](const Key &a, const Key &b) {
+      if (a.kind != b.kind) return a.kind < b.kind;
+      if (a.key != b.key) return a.key < b.key;
+      if (a.kind != 1) return false;
+      // the first bytes are the same: all of them, or the rest decides
+      const Cell &x = cells_[a.i], &y = cells_[b.i];
+      int c = x.size > 8 && y.size > 8 ?
+              memcmp(x.s + 8, y.s + 8, std::min(x.size, y.size) - 8) : 0;
+      if (!c) c = x.size - y.size;
+      return descending ? c > 0 : c < 0; };
+
+   // a slice a thread, then pairs of runs merged, half as many threads
+   // each round
+   auto at = [&](int s) { return slice(n, std::min(s, t), t); };
+   on_threads(t, [&](int s) {
+      std::stable_sort(v.begin() + at(s), v.begin() + at(s + 1), less); });
+   for (int run = 1; run < t; run *= 2) {
+      on_threads((t + 2 * run - 1) / (2 * run), [&](int j) {
+         const long a = at(2 * j * run), b = at((2 * j + 1) * run),
+                    c = at((2 * j + 2) * run);
+         std::merge(v.begin() + a, v.begin() + b, v.begin() + b,
+                    v.begin() + c, w.begin() + a, less); });
+      v.swap(w); }
+
+   std::vector<int> r(n);
+   for (int i = 0; i < n; i++) r[i] = line(v[i].i);
+   return r;
+}
+
+std::vector<int>
+Column::filter(const std::function<bool (Cell)> &f)
+{
+   const int n = size(), t = threads(n);
+   std::vector<std::vector<int>> kept(t);
+   on_threads(t, [&](int s) {
+      for (long i = slice(n, s, t); i < slice(n, s + 1, t); i++)
+         if (f(cells_[i])) kept[s].push_back(line(i)); });
+
+   std::vector<int> v;
+   size_t size = 0;
+   for (auto &k : kept) size += k.size();
+   v.reserve(size);
+   for (auto &k : kept) v.insert(v.end(), k.begin(), k.end());
+   return v;
+}
+
+void
+Sums::start(std::unique_ptr<Column> c, int k, Dsv d)
+{
+   stop();
+   column_ = std::move(c);
+   running_ = true;
+   done_ = false;
+   worker_ = std::thread([this, k, d]() {
+      if (column_->cut(k, d)) {
+         rows_ = column_->size();
+         stats_ = column_->stats();
+         texts_ = column_->texts(); }
+      done_ = true; });
+}
+
+void
+Sums::stop()
+{
+   if (!running_) return;
+   column_->cancel();
+   worker_.join();
+   column_.reset();
+   running_ = false;
+}
+
+bool
+Sums::change(Column::Value was, Column::Value is)
+{
+   const bool a = !std::isnan(was.number), b = !std::isnan(is.number);
+   if (a) {
+      stats_.count--;
+      stats_.sum -= was.number; }
+   if (b) {
+      stats_.count++;
+      stats_.sum += is.number; }
+   texts_ += is.text - was.text;
+   // a bound that went is only kept by one at least as far out
+   if (a && ((was.number == stats_.min && !(b && is.number <= was.number)) ||
+             (was.number == stats_.max && !(b && is.number >= was.number))))
+      return false;
+   if (b) {
+      stats_.min = std::min(stats_.min, is.number);
+      stats_.max = std::max(stats_.max, is.number); }
+   return true;
+}
+
+bool
+Sums::ready()
+{
+   if (running_ && done_) {
+      worker_.join();
+      column_.reset();
+      running_ = false; }
+   return !running_;
+}
+
+} // namespace
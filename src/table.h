@@ -0,0 +1,99 @@
+#ifndef table_h
+#define table_h
+
+#include <vector>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include "span.h"
+#include "fields.h"
+
+namespace e {
+
+class Buf;
+
+// One column of a DSV buffer laid out for sorting, filtering and summing
+// up: field k of each of a list of lines, pointing into the lines rather
+// than copied, and its value where it reads as a number.  Only the lines
+// an edit would free are copied, so that once taken it can be worked on
+// from any thread, edits or not.  Fields are cut out, parsed, sorted and
+// tested on as many threads as there are cores; the results are line
+// numbers, for a view to show the lines in.
+class Column {
+public:
+   struct Cell { const char *s; int size; };
+   // of the fields that are numbers
+   struct Stats {
+      long count; double sum, min, max;
+      double mean() const { return sum / count; } };
+   // what a field counts as: its number, or NaN and whether it is text
+   struct Value { double number; bool text; };
+
+   Column(Buf &b);                          // all of b's lines
+   Column(Buf &b, std::vector<int> lines);  // those, even if none
+   Column(const Column &) = delete;
+   Column &operator=(const Column &) = delete;
+   bool cut(int k, Dsv d);      // field k of the lines; false if cancelled
+   void cancel() { cancel_ = true; }
+   // field k of l, split as f, without the quotes around it if d has them
+   static Cell cell(Span l, const Fields &f, int k, Dsv d);
+   int  size() { return cells_.size(); }
+   bool numeric() { return numeric_; }  // most of its fields are numbers
+   long texts() { return texts_; }      // fields neither numbers nor empty
+   Stats stats();
+   static Value value(Cell c);
+
+   // the lines by field, numbers before other text and empty fields last;
+   // equal fields keep their order
+   std::vector<int> sorted(bool descending);
+   // those whose field f holds for, in order; f is called from any thread
+   std::vector<int> filter(const std::function<bool (Cell)> &f);
+
+private:
+   bool                all_;
+   std::vector<int>    lines_;
+   std::vector<char>   copies_;    // of the lines an edit would free
+   std::vector<Cell>   cells_;
+   std::vector<double> values_;    // NaN for a field that is no number
+   std::vector<unsigned long> heads_;  // first 8 bytes, big-endian
+   bool numeric_;
+   long texts_;
+   std::atomic<bool> cancel_;
+
+   int line(int i) { return all_ ? i : lines_[i]; }
+   void take(Buf &b);
+};
+
+// The cursor's column summed up on a worker thread (which cuts it on as
+// many more as there are cores), from a Column taken on this one.  A new
+// one cancels the one still going.
+class Sums {
+public:
+   Sums() : running_(false), done_(false), rows_(0), texts_(0), stats_ {} { }
+   ~Sums() { stop(); }
+   void start(std::unique_ptr<Column> c, int k, Dsv d);
+   void stop();
+   bool ready();               // not summing on the worker
+   // of the last one done
+   int  rows() { return rows_; }
+   bool numeric() { return stats_.count > texts_; }
+   const Column::Stats &stats() { return stats_; }
+   // one of the fields summed up was and now is; false if that takes away
+   // the min or max, which only a new count finds again
+   bool change(Column::Value was, Column::Value is);
+
+private:
+   std::unique_ptr<Column> column_;
+   std::thread worker_;
+   bool running_;
+   std::atomic<bool> done_;
+   int  rows_;
+   long texts_;
+   Column::Stats stats_;
+};
+
+} // namespace
+
+#endif
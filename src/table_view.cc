@@ -9,16 +9,18 @@
 #include <iostream>
 #include <algorithm>
 #include <sys/ioctl.h>
-#define COLOUR_ESC "\033"
-#define COLOUR_RED     COLOUR_ESC "[31m"
-#define COLOUR_CYAN    COLOUR_ESC "[36m"
-#define COLOUR_GREY    COLOUR_ESC "[38;5;248m"
-#define COLOUR_NORMAL  COLOUR_ESC "[0m"
-#define COLOUR_GREY_BG COLOUR_ESC "[48;5;248m"
+#define COLOUR_RED     Attr { Attr::fg, 1 }
+#define COLOUR_CYAN    Attr { Attr::fg, 6 }
+#define COLOUR_GREY    Attr { Attr::fg, 248 }
+#define COLOUR_NORMAL  Attr { Attr::normal }
+#define COLOUR_GREY_BG Attr { Attr::bg, 248 }
 
+#include "keywords.h"
+#include "screen.h"
 #include "str.h"
 #include "buf.h"
 #include "view.h"
+#include "table.h"
 #include "table_view.h"
 
 extern "C" {
@@ -33,20 +35,25 @@ int  lnum_col(int n);
 void lnum_padding_out(int n);
 int  max(int a, int b);
 
-extern std::vector<const char *> keywords;
+std::vector<char> &keyword_marks(Span s);
+
+int
+TableView::line(int r)
+{
+   if (!virtual_ || mapped_) return r >= 0 && r < buf_->num_of_lines() ? r : -1;
+   return r >= 0 && r < (int)rows_.size() ? rows_[r] : -1;
+}
 
 void
 TableView::cursor_move_word_next(int (*f)(int))
 {
-   const int row_prev = cursor_row_ + window_offset_;
-   if (row_prev < 0 || row_prev >= buf_->num_of_lines()) return;
-   Str s { buf_->get_line(row_prev) };
-   if (cursor_column_ > s.len()) return;
+   const int line = this->line(cursor_row_ + window_offset_);
+   if (line < 0) return;
+   if (cursor_column_ > buf_->get_line(line).len) return;
 
-   for (int i = cursor_column_ + 1; i < s.len(); i++)
-      if (s[i] == ':') {
-         cursor_column_ = i + 1;
-         break; }
+   const Fields &fs = buf_->fields(line);
+   const int k = fs.field(cursor_column_ + 1);
+   if (k < fs.count() - 1) cursor_column_ = fs.chars[k] + 1;
 }
 
 void
@@ -54,6 +61,7 @@ TableView::cursor_move_word_prev(int (*f)(int))
 {
 }
 
+// to the same field of the next row, or its head when there is none
 void
 TableView::cursor_move_row_rel(int n)
 {
@@ -65,81 +73,69 @@ TableView::cursor_move_row_rel(int n)
 
    const int row_next = cursor_row_ + window_offset_;
 
-   if (row_prev < 0 || row_prev >= buf_->num_of_lines()) return;
-   int c = 0;
-   const char *s { buf_->get_line(row_prev) };
-   for (int i = 0; i <= col_prev; i++)
-      if (s[i] == ':') c++;
+   if (line(row_prev) < 0) return;
+   const int c = buf_->fields(line(row_prev)).field(col_prev + 1);
+
+   if (line(row_next) < 0) return;
+   const Fields &f = buf_->fields(line(row_next));
+   if (c && c < f.count()) cursor_column_ = f.chars[c - 1] + 1;
+}
 
-   if (row_next < 0 || row_next >= buf_->num_of_lines()) return;
-   int c2 = 0;
-   const char *t { buf_->get_line(row_next) };
-   for (int i = 0; i < strlen(t); i++)
-      if (t[i] == ':' && ++c2 == c) {
-         Str s { t };
-         cursor_column_ = s.index_bytes_to_chars(i) + 1;
-         break; }
+// the separator, as the cursor on it shows it
+char
+sep_out(Dsv d)
+{
+   return d.sep == '\t' ? ' ' : d.sep;
 }
 
 void
-tableview_keyword_hilit_colour(const char *s, int col)
+tableview_keyword_hilit_colour(Span s, const Fields &f, Columns &cols, int col,
+                               char sep)
 {
    Str str { s };
-   int pos_start = 0;
    int len = str.len();
-   char *buf = (char *)malloc(str.len());
-   if (!buf) {
-      std::cout << s;
-      return; }
-   memset(buf, ' ', len);
-
-   for (;;) {
-      int pos_found = str.search_word(keywords, pos_start);
-      if (pos_found == -1) break;
-      auto w = str.match_word(keywords, pos_found);
-      if (!w) { pos_start++; continue; }
-      int len = Str(w).len();
-      memset(&buf[pos_found], '~', len);
-      pos_start = pos_found + len; }
-   if (col >= 0 && col < len)
-      buf[col] = '^';
-
-   const int cell_width = 16;
-   int cell_col = 0;
-   for (int i = 0; i < len; i++) {
-      if (str[i] == ':') {
-         for (int i = cell_col; i < cell_width; i++)
-            std::cout << ' ';
-         if (i == col)
-            std::cout << COLOUR_GREY_BG << ':' << COLOUR_NORMAL;
-         else
-            std::cout << COLOUR_CYAN << '|' << COLOUR_NORMAL;
-         cell_col = 1;
-         continue;
-      }
-      if (cell_col == cell_width - 1 && str[i + 1] != ':') {
-         int found = 0;
-         for (int j = i; j < len && str[j] != ':'; j++)
-            if (j == col) found = 1;
-         if (found) {
+   auto &buf = keyword_marks(s); // by byte
+
+   for (int k = 0, pm = ' ', m = ' '; k < f.count(); k++) {
+      const int end = k < f.count() - 1 ? f.chars[k] : len;
+      // the separator before it is the cell's first column
+      const int cell_width = cols.width(k) + (k ? 1 : 0);
+      int cell_col = k ? 1 : 0;
+      // a cell shows the head of its field; what does not fit is a '>'
+      // (or the cursor, if it is in there) and skipped
+      for (auto c = str.at(f.start(k), f.start_byte(k));
+           c.index() < end && cell_col < cell_width; ++c, pm = m) {
+         m = c.index() == col ? '^' : buf[c.pos()];
+         if (cell_col == cell_width - 1 && c.index() + 1 < end) {
+            if (col >= c.index() && col < end) {
+               std::cout << COLOUR_GREY_BG;
+               str.output_char(col);
+               std::cout << COLOUR_NORMAL; }
+            else
+               std::cout << COLOUR_CYAN << '>' << COLOUR_NORMAL;
+            cell_col++;
+            break; }
+
+         if (pm != '~' && m == '~')
+            std::cout << COLOUR_RED;
+         if (pm == '~' && m != '~')
+            std::cout << COLOUR_NORMAL;
+         if (m == '^')
             std::cout << COLOUR_GREY_BG;
-            str.output_char(col);
-            std::cout << COLOUR_NORMAL; }
-         else
-            std::cout << COLOUR_CYAN << '>' << COLOUR_NORMAL;
+         c.output();
+         if (m == '^')
+            std::cout << COLOUR_NORMAL;
          cell_col++; }
-      if (cell_col >= cell_width) continue;
-
-      if ((!i || buf[i - 1] != '~') && buf[i] == '~')
-         std::cout << COLOUR_RED;
-      if (i && buf[i - 1] == '~' && buf[i] != '~')
-         std::cout << COLOUR_NORMAL;
-      if (buf[i] == '^')
-         std::cout << COLOUR_GREY_BG;
-      str.output_char(i);
-      if (buf[i] == '^')
-         std::cout << COLOUR_NORMAL;
-      cell_col++; }
+      if (end == len) break;
+
+      // the separator
+      for (int i = cell_col; i < cell_width; i++)
+         std::cout << ' ';
+      if (end == col)
+         std::cout << COLOUR_GREY_BG << sep << COLOUR_NORMAL;
+      else
+         std::cout << COLOUR_CYAN << '|' << COLOUR_NORMAL;
+      pm = end == col ? '^' : buf[f.bytes[k]]; }
 
    // EOL
    std::cout << COLOUR_NORMAL;
@@ -151,18 +147,17 @@ tableview_keyword_hilit_colour(const char *s, int col)
 }
 
 void
-show_content_under_cursor(const char *str, int col)
+show_content_under_cursor(Span str, const Fields &f, int col, char sep)
 {
    Str s(str);
-   int cursor_cell = 0;
-   for (int i = 0; i < s.len() && i < col; i++)
-      if (s[i] == ':') cursor_cell = i + 1;
-   for (int j = cursor_cell; j < s.len() && s[j] != ':'; j++) {
-      if (j == col) std::cout << COLOUR_GREY_BG;
-      s.output_char(j);
-      if (j == col) std::cout << COLOUR_NORMAL; }
-   if (s[col] == ':')
-      std::cout << COLOUR_GREY_BG << ':' << COLOUR_NORMAL;
+   const int k = f.field(col);
+   const int end = k < f.count() - 1 ? f.chars[k] : s.len();
+   for (auto j = s.at(f.start(k), f.start_byte(k)); j.index() < end; ++j) {
+      if (j.index() == col) std::cout << COLOUR_GREY_BG;
+      j.output();
+      if (j.index() == col) std::cout << COLOUR_NORMAL; }
+   if (f.separator(col))
+      std::cout << COLOUR_GREY_BG << sep << COLOUR_NORMAL;
    if (col == s.len())
       std::cout << COLOUR_GREY_BG << '$' << COLOUR_NORMAL;
    eol_out();
@@ -171,22 +166,34 @@ show_content_under_cursor(const char *str, int col)
 void
 TableView::show()
 {
-   std::vector<const char *> v;
+   std::vector<Span> v;
    const int from = window_offset_, to = window_offset_ + window_height_;
    const int cursor_line = window_offset_ + cursor_row_;
-   const int lnum_col_max = max(lnum_col(from), lnum_col(to - 1));
+   // line numbers are the buffer's, so the widest there is when sorted
+   const int lnum_col_max = max(max(lnum_col(from), lnum_col(to - 1)),
+                                virtual_ ? lnum_col(buf_->num_of_lines()) : 0);
 
-   buf_->show(v, from, to);
+   if (virtual_)
+      for (int i = max(from, 0); i < to && i < rows(); i++)
+         v.push_back(buf_->get_line(rows_[i]));
+   else
+      buf_->show(v, from, to);
 
    std::cout << COLOUR_GREY_BG;
    std::cout << "== " << buf_->filename() <<
                 (buf_->new_file() ? " N" : buf_->dirty() ? " *" : "") <<
-                " [" << from << ":" << to << "] ==";
+                " [" << from << ":" << to << "]";
+   status_out();
+   dsv_out();
+   rows_out();
+   std::cout << " ==";
    eol_out();
    std::cout << COLOUR_NORMAL;
 
-   if (cursor_line >= 0 && cursor_line < buf_->num_of_lines())
-      show_content_under_cursor(buf_->get_line(cursor_line), cursor_column_);
+   if (line(cursor_line) >= 0)
+      show_content_under_cursor(buf_->get_line(line(cursor_line)),
+                                buf_->fields(line(cursor_line)), cursor_column_,
+                                sep_out(buf_->dsv()));
    else
       eol_out();
 
@@ -199,9 +206,11 @@ TableView::show()
 
    int n = (from < 0) ? 0 : from;
    for (auto i : v) {
-      lnum_padding_out(lnum_col_max - lnum_col(n));
-      std::cout << COLOUR_GREY << n << ": " << COLOUR_NORMAL;
-      tableview_keyword_hilit_colour(i, n == cursor_line ? cursor_column_ : -1);
+      lnum_padding_out(lnum_col_max - lnum_col(line(n)));
+      std::cout << COLOUR_GREY << line(n) << ": " << COLOUR_NORMAL;
+      tableview_keyword_hilit_colour(i, buf_->fields(line(n)), buf_->columns(),
+                                     n == cursor_line ? cursor_column_ : -1,
+                                     sep_out(buf_->dsv()));
       eol_out();
       ++n; }
 
@@ -213,7 +222,240 @@ TableView::show()
 
    show_keywords();
    show_rot13();
+   sums_out();
    std::cout << COLOUR_NORMAL;
 }
 
+// the cursor's field over all the rows, again once the cursor is in another
+// one or the rows have changed, or an edit edit_line() could not sum up
+// itself; edits made meanwhile wait for it
+void
+TableView::sum_up()
+{
+   const int line = this->line(window_offset_ + cursor_row_);
+   if (buf_->loading()) return;
+   // past the last row, or with none, the field the cursor was last in
+   const int k = line >= 0 ? buf_->fields(line).field(cursor_column_) :
+                 sums_of_.k;
+   const SumsOf s { k, buf_->dsv(), row_set_, buf_->changes() };
+   if (s.k < 0) return;
+   if (s == sums_of_) return;
+   if (s.k == sums_of_.k && s.dsv == sums_of_.dsv && s.rows == sums_of_.rows &&
+       !sums_.ready()) return;
+   sums_of_ = s;
+   sums_.start(column(), s.k, s.dsv);
+}
+
+// line's field in the sums
+Column::Value
+TableView::summed(int line)
+{
+   return Column::value(Column::cell(buf_->get_line(line), buf_->fields(line),
+                                     sums_of_.k, sums_of_.dsv));
+}
+
+// "[field 3: 1000 numbers, sum 5050, min 1, max 100, mean 50.5]", if most
+// of the field is numbers; "..." while they are being summed up
+void
+TableView::sums_out()
+{
+   sum_up();
+   if (sums_of_.k < 0) return;
+   std::cout << "[field " << sums_of_.k + 1 << ": ";
+   if (!sums_.ready()) {
+      std::cout << "...]";
+      eol_out();
+      return; }
+   const Column::Stats &st = sums_.stats();
+   if (!sums_.rows()) {
+      std::cout << "no rows]";
+      eol_out();
+      return; }
+   if (!sums_.numeric() || !st.count) {
+      std::cout << "text]";
+      eol_out();
+      return; }
+   char s[160];
+   snprintf(s, sizeof s, "%ld numbers, sum %.10g, min %.10g, max %.10g, mean %.10g]",
+            st.count, st.sum, st.min, st.max, st.mean());
+   std::cout << s;
+   eol_out();
+}
+
+// " [sep , quoted]", unless it is the usual ':'
+void
+TableView::dsv_out()
+{
+   const Dsv d = buf_->dsv();
+   if (d == Dsv()) return;
+   std::cout << " [sep ";
+   if (d.sep == '\t') std::cout << "tab"; else std::cout << d.sep;
+   std::cout << (d.quoted ? " quoted]" : "]");
+}
+
+// " [sort 3 desc, 2 = x: 120 of 5000 rows]"; fields count from 1
+void
+TableView::rows_out()
+{
+   if (!virtual_) return;
+   std::cout << " [" << sort_ << (sort_.empty() || filter_.empty() ? "" : ", ") <<
+                filter_ << ": " << rows_.size() << " of " <<
+                buf_->num_of_lines() << " rows]";
+}
+
+void
+TableView::paste(const char *s, int size)
+{
+   if (virtual_ && (memchr(s, '\n', size) || memchr(s, '\r', size))) return;
+   edit_line([=] { View::paste(s, size); });
+}
+
+// not past the end of the line, which would join the next one
+void
+TableView::char_delete_forward()
+{
+   if (virtual_ && cursor_column_ >= buf_->line_length(line(window_offset_ + cursor_row_)))
+      return;
+   edit_line([this] { View::char_delete_forward(); });
+}
+
+void
+TableView::char_delete_backward()
+{
+   if (virtual_) {
+      cursor_column_ = std::min(cursor_column_,
+                                buf_->line_length(line(window_offset_ + cursor_row_)));
+      if (!cursor_column_) return; }
+   edit_line([this] { View::char_delete_backward(); });
+}
+
+// the cursor row first, then the rows after it in turn
+void
+TableView::keyword_search_next()
+{
+   if (!virtual_) return View::keyword_search_next();
+   const int row = window_offset_ + cursor_row_;
+   for (int r = max(row, 0); r < rows(); r++) {
+      Str s { buf_->get_line(rows_[r]) };
+      auto found = s.search_word(keywords, r == row ? cursor_column_ + 1 : 0);
+      if (found != -1) { cursor_goto(r, found); return; } }
+}
+
+void
+TableView::keyword_search_prev()
+{
+   if (!virtual_) return View::keyword_search_prev();
+   const int row = window_offset_ + cursor_row_;
+   for (int r = std::min(row, rows() - 1); r >= 0; r--) {
+      Str s { buf_->get_line(rows_[r]) };
+      auto found = s.search_word_prev(keywords,
+                                      r == row ? std::min(cursor_column_, s.len()) : s.len());
+      if (found != -1) { cursor_goto(r, found); return; } }
+}
+
+// the rows shown, even none, or else all the lines
+std::unique_ptr<Column>
+TableView::column()
+{
+   return std::unique_ptr<Column>(virtual_ ? new Column(*buf_, rows_) :
+                                             new Column(*buf_));
+}
+
+// back on line if it is still shown, else to the top
+void
+TableView::cursor_to(int line)
+{
+   auto i = std::find(rows_.begin(), rows_.end(), line);
+   if (i != rows_.end())
+      cursor_goto(i - rows_.begin(), cursor_column_);
+   else
+      window_offset_ = cursor_row_ = 0;
+}
+
+void
+TableView::sort_rows(bool descending)
+{
+   const int line = this->line(window_offset_ + cursor_row_);
+   if (line < 0) return;
+   const int k = buf_->fields(line).field(cursor_column_);
+
+   buf_->wait_loaded();
+   auto c = column();
+   c->cut(k, buf_->dsv());
+   rows_ = c->sorted(descending);
+   virtual_ = true;
+   sort_ = "sort " + std::to_string(k + 1) + (c->numeric() ? " num" : "") +
+           (descending ? " desc" : "");
+   cursor_to(line);
+}
+
+void
+TableView::filter_rows(char how)
+{
+   const int line = this->line(window_offset_ + cursor_row_);
+   if (line < 0 || (how == '~' && keywords.empty())) return;
+   const Fields &f = buf_->fields(line);
+   const int k = f.field(cursor_column_);
+   const Column::Cell v = Column::cell(buf_->get_line(line), f, k, buf_->dsv());
+   auto equal = [v](Column::Cell c) {
+      return c.size == v.size && !memcmp(c.s, v.s, v.size); };
+
+   buf_->wait_loaded();
+   auto c = column();
+   c->cut(k, buf_->dsv());
+   if (how == '~')
+      rows_ = c->filter([](Column::Cell c) {
+         return keywords.find(Span { c.s, c.size }, 0) >= 0; });
+   else if (how == '=')
+      rows_ = c->filter(equal);
+   else
+      rows_ = c->filter([&equal](Column::Cell c) { return !equal(c); });
+   virtual_ = true;
+   row_set_++;
+
+   // the value, cut to a few chars
+   int n = std::min(v.size, 12);
+   while (n < v.size && n && (v.s[n] & 0xc0) == 0x80) n--;
+   filter_ += (filter_.empty() ? "" : ", ") + std::to_string(k + 1) +
+              (how == '~' ? " ~ keywords" : how == '=' ? " = " : " != ") +
+              (how == '~' ? "" : std::string(v.s, n) + (n < v.size ? "..." : ""));
+   cursor_to(line);
+}
+
+// the char under the cursor, as long as it is ASCII
+void
+TableView::separator()
+{
+   const int line = this->line(window_offset_ + cursor_row_);
+   if (line < 0) return;
+   Str s { buf_->get_line(line) };
+   if (cursor_column_ >= s.len()) return;
+   const int c = s[cursor_column_];
+   if (c <= 0 || c >= 0x80 || c == '"') return;
+   Dsv d = buf_->dsv();
+   d.sep = c;
+   buf_->dsv(d);
+}
+
+void
+TableView::quotes()
+{
+   Dsv d = buf_->dsv();
+   d.quoted = !d.quoted;
+   buf_->dsv(d);
+}
+
+void
+TableView::all_rows()
+{
+   if (!virtual_) return;
+   const int line = this->line(window_offset_ + cursor_row_);
+   virtual_ = false;
+   row_set_++;
+   std::vector<int>().swap(rows_);
+   sort_.clear();
+   filter_.clear();
+   if (line >= 0) cursor_goto(line, cursor_column_);
+}
+
 } // namespace
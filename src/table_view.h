@@ -1,20 +1,127 @@
 #ifndef table_view_h
 #define table_view_h
 
+#include <string>
+#include <vector>
+
 #include "buf.h"
 #include "view.h"
+#include "table.h"
 
 namespace e {
 
 class TableView : public View {
 public:
-   TableView(Buf *b) : View(b) { }
+   TableView(Buf *b) : View(b), virtual_(false), row_set_(0), mapped_(false),
+      editing_(false), sums_of_ { -1, Dsv(), -1, -1 } {
+      b->columns().build(); }
    void show();
+   void window_bottom() { window_offset_ = rows() - window_height_; }
    void cursor_move_row_rel(int n);
+   void cursor_move_char_end() { on_line([this] { View::cursor_move_char_end(); }); }
    void cursor_move_word_next(int (*f)(int));
    void cursor_move_word_prev(int (*f)(int));
+   void cursor_move_para_next() { if (!virtual_) View::cursor_move_para_next(); }
+   void cursor_move_para_prev() { if (!virtual_) View::cursor_move_para_prev(); }
+
+   void keyword_search_next();
+   void keyword_search_prev();
+   void keyword_toggle() { on_line([this] { View::keyword_toggle(); }); }
+   void show_rot13()     { on_line([this] { View::show_rot13(); }); }
+
+   // with the rows sorted or filtered, only edits within a line
+   void indent() { if (!virtual_) View::indent(); }
+   void exdent() { if (!virtual_) View::exdent(); }
+   void join()   { if (!virtual_) View::join(); }
+   void duplicate_line()  { if (!virtual_) View::duplicate_line(); }
+   void transpose_lines() { if (!virtual_) View::transpose_lines(); }
+   void new_line()        { if (!virtual_) View::new_line(); }
+   void insert_new_line(bool left) { if (!virtual_) View::insert_new_line(left); }
+   void transpose_chars() { edit_line([this] { View::transpose_chars(); }); }
+   void char_insert(char c) { edit_line([this, c] { View::char_insert(c); }); }
+   void paste(const char *s, int size);
+   void char_delete_forward();
+   void char_delete_backward();
+   void char_delete_to_eol() { edit_line([this] { View::char_delete_to_eol(); }); }
+   void char_delete_to_bol() { edit_line([this] { View::char_delete_to_bol(); }); }
+   void char_rotate_variant() { edit_line([this] { View::char_rotate_variant(); }); }
+
+   void separator();
+   void quotes();
+   void sort_rows(bool descending);
+   void filter_rows(char how);
+   void all_rows();
+   bool ready() { return sums_.ready(); }
+
+private:
+   // Sorted or filtered, row r of the view is line rows_[r] of the buffer;
+   // no line is copied or moved.  Line numbers stay put as nothing can
+   // add or remove a line meanwhile.
+   bool virtual_;
+   std::vector<int> rows_;
+   std::string sort_, filter_;   // how they came about, for the mode line
+   long row_set_;                // counts the times rows_ has other lines
+   bool mapped_;                 // in on_line()
+   bool editing_;                // in edit_line()
+
+   // what sums_ are of: the field, the split, the rows and the edits made
+   struct SumsOf {
+      int k; Dsv dsv; long rows, changes;
+      bool operator==(const SumsOf &s) const {
+         return k == s.k && dsv == s.dsv && rows == s.rows && changes == s.changes; }
+   };
+   Sums   sums_;
+   SumsOf sums_of_;
+
+   int  rows() { return virtual_ ? rows_.size() : buf_->num_of_lines(); }
+   int  line(int r);             // the line row r shows, -1 for none
+   template <class F> void on_line(F f);
+   template <class F> void edit_line(F f);
+   Column::Value summed(int line);
+   std::unique_ptr<Column> column();
+   void cursor_to(int line);
+   void dsv_out();
+   void rows_out();
+   void sum_up();
+   void sums_out();
 };
 
+// f, a View command on the cursor row, run on the line the row shows
+template <class F> void
+TableView::on_line(F f)
+{
+   if (!virtual_ || mapped_) return f();
+   const int line = this->line(window_offset_ + cursor_row_);
+   if (line < 0) return;
+   const int offset = window_offset_;
+   window_offset_ = line - cursor_row_;
+   mapped_ = true;
+   f();
+   mapped_ = false;
+   window_offset_ = offset;
+}
+
+// f, an edit of the cursor row, run as on_line(); if the sums were up to
+// date, the line's field goes out of them and back in as it is now, so
+// they need no new count
+template <class F> void
+TableView::edit_line(F f)
+{
+   if (editing_) return on_line(f);     // the View command calls another
+   const int line = this->line(window_offset_ + cursor_row_);
+   const int n = buf_->num_of_lines();
+   const long c = buf_->changes();
+   const bool kept = line >= 0 && sums_.ready() && sums_of_.changes == c &&
+                     sums_of_.rows == row_set_ && sums_of_.dsv == buf_->dsv();
+   const Column::Value was = kept ? summed(line) : Column::Value { };
+   editing_ = true;
+   on_line(f);
+   editing_ = false;
+   if (kept && buf_->changes() != c && buf_->num_of_lines() == n &&
+       sums_.change(was, summed(line)))
+      sums_of_.changes = buf_->changes();
+}
+
 } // namespace
 
 #endif
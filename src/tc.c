@@ -1,6 +1,7 @@
 #include <termcap.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 int
 tc_err(const char *s, int n)
@@ -11,24 +12,103 @@ tc_err(const char *s, int n)
 
 char buf[2048];
 
+/* every capability the editor uses, looked up once by tc_init; the
+   colours fall back to the ANSI sequences when the terminal has none */
+static struct {
+   const char *name;
+   const char *s;
+} caps[] = {
+   { "ti" }, { "te" }, { "cl" }, { "cd" }, { "ce" }, { "cm" }, { "me" },
+};
+
+static const char *fg[256], *bg[256];
+
+static char  pool[16384];
+static char *pool_p = pool;
+
+static int
+pool_putc(int c)
+{
+   if (pool_p < pool + sizeof pool - 1) *pool_p++ = c;
+   return c;
+}
+
+/* s with its padding done, kept in the pool */
+static const char *
+keep(const char *s)
+{
+   const char *r = pool_p;
+
+   tputs(s, 1, pool_putc);
+   pool_putc('\0');
+   return r;
+}
+
+static const char *
+colour(const char *af, int colours, const char *ansi, int n)
+{
+   char s[32];
+
+   if (af && n < colours) return keep(tgoto(af, 0, n));
+   snprintf(s, sizeof s, ansi, n);
+   return keep(s);
+}
+
 int
 tc_init(void)
 {
-   char *term;
+   char *term, s[2048], *p;
+   const char *af, *ab;
+   int i, colours;
 
    if ((term = getenv("TERM")) == NULL) return tc_err("getenv", 1);
    if ((tgetent(buf, term)) < 0)        return tc_err("tgetent", 1);
+
+   for (i = 0; i < sizeof caps / sizeof *caps; i++) {
+      p = s;
+      if (!tgetstr(caps[i].name, &p)) continue;
+      /* cm is a format, done per call */
+      caps[i].s = strcmp(caps[i].name, "cm") ? keep(s) : strdup(s); }
+
+   p = s;
+   af = tgetstr("AF", &p);
+   ab = tgetstr("AB", &p);
+   colours = tgetnum("Co");
+   for (i = 0; i < 256; i++) {
+      fg[i] = colour(af, colours, "\033[38;5;%dm", i);
+      bg[i] = colour(ab, colours, "\033[48;5;%dm", i); }
    return 0;
 }
 
+/* the string for cap, "" if the terminal has none */
+const char *
+tc_str(const char *cap)
+{
+   int i;
+
+   for (i = 0; i < sizeof caps / sizeof *caps; i++)
+      if (!strcmp(caps[i].name, cap))
+         return caps[i].s ? caps[i].s :
+                !strcmp(cap, "me") ? "\033[0m" : "";
+   return "";
+}
+
+/* cursor motion to col, row */
+const char *
+tc_goto(int col, int row)
+{
+   const char *cm = tc_str("cm");
+
+   return *cm ? tgoto(cm, col, row) : "";
+}
+
+const char *tc_fg(int n) { return fg[n & 255] ? fg[n & 255] : ""; }
+const char *tc_bg(int n) { return bg[n & 255] ? bg[n & 255] : ""; }
+
 int
 tc(const char *cap)
 {
-   char  s[2048];
-   char *p = s;
-
-   if (tgetstr(cap, &p) < 0) return tc_err("tgetstr", 1);
-   tputs(s, 1, putchar);
+   fputs(tc_str(cap), stdout);
    return 0;
 }
 
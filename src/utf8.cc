@@ -0,0 +1,183 @@
+#include <cstdint>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define UTF8_X86 1
+#endif
+
+#include "utf8.h"
+
+namespace e {
+
+namespace {
+
+inline bool lead(char c) { return (c & 0xc0) != 0x80; }
+
+int
+scalar_count(const char *s, int size)
+{
+   int l = 0;
+   for (int i = 0; i < size; i++)
+      if (lead(s[i])) l++;
+   return l;
+}
+
+int
+scalar_offset(const char *s, int size, int n)
+{
+   int l = 0;
+   for (int i = 0; i < size; i++)
+      if (lead(s[i]) && l++ == n)
+         return i;
+   return size;
+}
+
+#ifdef UTF8_X86
+
+// As signed bytes continuation bytes are -128..-65, everything else is
+// greater, so one compare marks the char starts.  The SSE2 bodies are
+// always inlined so that the AVX2 kernels get them VEX-encoded for their
+// tails rather than paying for a switch back to legacy SSE.
+
+#define UTF8_INLINE inline __attribute__((always_inline))
+
+UTF8_INLINE int
+sse2_count_body(const char *s, int size)
+{
+   const __m128i k = _mm_set1_epi8(-65);
+   int l = 0, i = 0;
+
+   while (size - i >= 16) {
+      // per-lane counters (0 - -1 per start) are summed before they wrap
+      __m128i acc = _mm_setzero_si128();
+      for (int j = 0; j < 255 && size - i >= 16; j++, i += 16) {
+         __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+         acc = _mm_sub_epi8(acc, _mm_cmpgt_epi8(v, k)); }
+      __m128i sum = _mm_sad_epu8(acc, _mm_setzero_si128());
+      l += _mm_cvtsi128_si32(sum) + _mm_extract_epi16(sum, 4); }
+   return l + scalar_count(s + i, size - i);
+}
+
+UTF8_INLINE int
+sse2_offset_body(const char *s, int size, int n)
+{
+   const __m128i k = _mm_set1_epi8(-65);
+   int i = 0;
+
+   // skip 64 bytes at a time by their count, then find the char in 16s
+   for (; size - i >= 64; i += 64) {
+      __m128i acc = _mm_setzero_si128();
+      for (int j = 0; j < 64; j += 16) {
+         __m128i v = _mm_loadu_si128((const __m128i *)(s + i + j));
+         acc = _mm_sub_epi8(acc, _mm_cmpgt_epi8(v, k)); }
+      __m128i sum = _mm_sad_epu8(acc, _mm_setzero_si128());
+      int c = _mm_cvtsi128_si32(sum) + _mm_extract_epi16(sum, 4);
+      if (n < c) break;
+      n -= c; }
+
+   for (; size - i >= 16; i += 16) {
+      __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+      unsigned m = _mm_movemask_epi8(_mm_cmpgt_epi8(v, k));
+      int c = __builtin_popcount(m);
+      if (n < c) {
+         for (; n; n--) m &= m - 1;
+         return i + __builtin_ctz(m); }
+      n -= c; }
+   return i + scalar_offset(s + i, size - i, n);
+}
+
+int
+sse2_count(const char *s, int size)
+{
+   return sse2_count_body(s, size);
+}
+
+int
+sse2_offset(const char *s, int size, int n)
+{
+   return sse2_offset_body(s, size, n);
+}
+
+__attribute__((target("avx2"))) int
+avx2_count(const char *s, int size)
+{
+   const __m256i k = _mm256_set1_epi8(-65);
+   int l = 0, i = 0;
+
+   while (size - i >= 32) {
+      __m256i acc = _mm256_setzero_si256();
+      for (int j = 0; j < 255 && size - i >= 32; j++, i += 32) {
+         __m256i v = _mm256_loadu_si256((const __m256i *)(s + i));
+         acc = _mm256_sub_epi8(acc, _mm256_cmpgt_epi8(v, k)); }
+      __m256i sum = _mm256_sad_epu8(acc, _mm256_setzero_si256());
+      l += _mm256_extract_epi64(sum, 0) + _mm256_extract_epi64(sum, 1) +
+           _mm256_extract_epi64(sum, 2) + _mm256_extract_epi64(sum, 3); }
+   return l + sse2_count_body(s + i, size - i);
+}
+
+__attribute__((target("avx2,popcnt"))) int
+avx2_offset(const char *s, int size, int n)
+{
+   const __m256i k = _mm256_set1_epi8(-65);
+   int i = 0;
+
+   for (; size - i >= 32; i += 32) {
+      __m256i v = _mm256_loadu_si256((const __m256i *)(s + i));
+      unsigned m = _mm256_movemask_epi8(_mm256_cmpgt_epi8(v, k));
+      int c = __builtin_popcount(m);
+      if (n < c) {
+         for (; n; n--) m &= m - 1;
+         return i + __builtin_ctz(m); }
+      n -= c; }
+   return i + sse2_offset_body(s + i, size - i, n);
+}
+
+#endif
+
+const Utf8Kernel *
+choose()
+{
+#ifdef UTF8_X86
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+      return &utf8_kernels[2];
+   return &utf8_kernels[1];
+#else
+   return &utf8_kernels[0];
+#endif
+}
+
+// scalar until static initialisation gets here
+const Utf8Kernel *kernel = &utf8_kernels[0];
+const bool chosen = (kernel = choose(), true);
+
+}
+
+const Utf8Kernel utf8_kernels[] = {
+   { "scalar", scalar_count, scalar_offset },
+#ifdef UTF8_X86
+   { "sse2",   sse2_count,   sse2_offset },
+   { "avx2",   avx2_count,   avx2_offset },
+#endif
+   { nullptr,  nullptr,      nullptr },
+};
+
+const Utf8Kernel &
+utf8_kernel()
+{
+   return *kernel;
+}
+
+int
+utf8_count(const char *s, int size)
+{
+   return kernel->count(s, size);
+}
+
+int
+utf8_offset(const char *s, int size, int n)
+{
+   return n < 0 ? size : kernel->offset(s, size, n);
+}
+
+} // namespace
@@ -0,0 +1,25 @@
+#ifndef utf8_h
+#define utf8_h
+
+namespace e {
+
+// Char counting over UTF-8 bytes.  A char starts at every byte that is not
+// a continuation byte (10xxxxxx), which is how Str has always counted.
+
+int utf8_count(const char *s, int size);         // chars in s[0, size)
+int utf8_offset(const char *s, int size, int n); // byte where char n starts,
+                                                 // size if there is none
+
+// the implementations utf8_count()/utf8_offset() choose from at start-up
+struct Utf8Kernel {
+   const char *name;
+   int (*count)(const char *s, int size);
+   int (*offset)(const char *s, int size, int n);
+};
+
+extern const Utf8Kernel utf8_kernels[];   // ends with a null name
+const Utf8Kernel &utf8_kernel();          // the one in use
+
+} // namespace
+
+#endif
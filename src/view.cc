@@ -6,54 +6,50 @@
 #include <cstring>
 #include <cstdio>
 #include <vector>
+#include <string>
 #include <iostream>
 #include <algorithm>
 #include <sys/ioctl.h>
-#define COLOUR_ESC "\033"
-#define COLOUR_RED     COLOUR_ESC "[31m"
-#define COLOUR_CYAN    COLOUR_ESC "[36m"
-#define COLOUR_GREY    COLOUR_ESC "[38;5;248m"
-#define COLOUR_NORMAL  COLOUR_ESC "[0m"
-#define COLOUR_GREY_BG COLOUR_ESC "[48;5;248m"
-
+#define COLOUR_RED     Attr { Attr::fg, 1 }
+#define COLOUR_CYAN    Attr { Attr::fg, 6 }
+#define COLOUR_GREY    Attr { Attr::fg, 248 }
+#define COLOUR_NORMAL  Attr { Attr::normal }
+#define COLOUR_GREY_BG Attr { Attr::bg, 248 }
+
+#include "alloc.h"
+#include "screen.h"
+#include "keywords.h"
+#include "latency.h"
 #include "str.h"
 #include "buf.h"
 #include "view.h"
 
-extern "C" {
-   int tc_init();
-   int tc(const char *);
-}
-
 namespace e {
 
 int min(int a, int b) { return (a < b) ? a : b; }
 int max(int a, int b) { return (a > b) ? a : b; }
 
-std::vector<const char *> keywords;
-
 View::View(Buf * buf) :
    buf_(buf),
    window_offset_(0),
    cursor_row_(0),
-   cursor_column_(0)
+   cursor_column_(0),
+   search_(0)
 {
-   struct winsize w;
+   resize();
+}
 
-   /* see tty_ioctl(4) */
-   ioctl(STDIN_FILENO, TIOCGWINSZ, &w);
-   window_width_  = w.ws_col;
-   window_height_ = w.ws_row - 6;
+void
+View::resize()
+{
+   int rows;
+   screen.size(window_width_, rows);
+   window_height_ = rows - 6;
 }
 
 void
 View::window_centre_cursor() {
-   struct winsize w;
-
-   /* see tty_ioctl(4) */
-   ioctl(STDIN_FILENO, TIOCGWINSZ, &w);
-   window_width_  = w.ws_col;
-   window_height_ = w.ws_row - 6;
+   resize();
 
    int t = window_height_ / 2;
    window_offset_ += cursor_row_ - t;
@@ -86,11 +82,12 @@ lnum_padding_out(int n)
    repeated_char_out(n, ' ');
 }
 
+// the screen clears what is left of a row when it paints it; nothing is
+// flushed until the frame is done
 void
 eol_out()
 {
-   tc("ce");
-   std::cout << std::endl;
+   std::cout << '\n';
 }
 
 void
@@ -102,58 +99,57 @@ keyword_hilit_uline(int n)
 void
 show_ruler(int padding, int col, int width)
 {
-   std::cout << COLOUR_GREY;
-   tc("ce");
-   lnum_padding_out(padding);
-
+   std::string r(padding, ' ');
+   char s[16];
    const int n = (width - padding - 1) / 8;
-   for (int i = 0; i < n; i++)
-      printf("0    %3o", i + 1);
-   std::cout << '0';
-   std::cout << COLOUR_NORMAL;
+   for (int i = 0; i < n; i++) {
+      snprintf(s, sizeof s, "0    %3o", i + 1);
+      r += s; }
+   r += '0';
 
-   tc("cr");
-   for (int i = 0; i < padding + col; i++)
-      tc("nd");
-   std::cout << '*' << std::endl;
+   // the cursor column, drawn over the ruler
+   const int at = max(0, min(padding + col, width - 1));
+   if (at >= (int)r.size()) r.resize(at + 1, ' ');
+   std::cout << COLOUR_GREY << r.substr(0, at) << COLOUR_NORMAL << '*' <<
+                COLOUR_GREY << r.substr(at + 1) << COLOUR_NORMAL << '\n';
+}
+
+// '~' under every byte of a keyword in s, ' ' elsewhere; valid until the
+// next call
+std::vector<char> &
+keyword_marks(Span s)
+{
+   static std::vector<char> v;
+   v.assign(s.size, ' ');
+   keywords.scan(s, 0, [](int b0, int b1, const char *) {
+         memset(&v[b0], '~', b1 - b0);
+         return false; });
+   return v;
 }
 
 void
-View::keyword_hilit_colour(const char *s, int col, int width)
+View::keyword_hilit_colour(Span s, int col, int width)
 {
    Str str { s };
-   int pos_start = 0;
    int len = str.len();
-   char *buf = (char *)malloc(str.len());
-   if (!buf) {
-      std::cout << s;
-      return; }
-   memset(buf, ' ', len);
-
-   for (;;) {
-      int pos_found = str.search_word(keywords, pos_start);
-      if (pos_found == -1) break;
-      auto w = str.match_word(keywords, pos_found);
-      if (!w) { pos_start++; continue; }
-      int len = Str(w).len();
-      memset(&buf[pos_found], '~', len);
-      pos_start = pos_found + len; }
-   if (col >= 0 && col < len)
-      buf[col] = '^';
-
-   for (int i = 0; i < len; i++) {
+   auto &buf = keyword_marks(s); // by byte
+
+   auto c = str.at(0);
+   for (int i = 0, prev = ' '; i < len; i++, ++c) {
       if (i == width - 1) {
          std::cout << COLOUR_RED << '>' << COLOUR_NORMAL;
          return; }
-      if ((!i || buf[i - 1] != '~') && buf[i] == '~')
+      const char m = i == col ? '^' : buf[c.pos()];
+      if (prev != '~' && m == '~')
          std::cout << COLOUR_RED;
-      if (i && buf[i - 1] == '~' && buf[i] != '~')
+      if (prev == '~' && m != '~')
          std::cout << COLOUR_NORMAL;
-      if (buf[i] == '^')
+      if (m == '^')
          std::cout << COLOUR_GREY_BG;
-      str.output_char(i);
-      if (buf[i] == '^')
-         std::cout << COLOUR_NORMAL; }
+      c.output();
+      if (m == '^')
+         std::cout << COLOUR_NORMAL;
+      prev = m; }
 
    // EOL
    std::cout << COLOUR_NORMAL;
@@ -163,7 +159,7 @@ View::keyword_hilit_colour(const char *s, int col, int width)
       std::cout << COLOUR_GREY;
    std::cout << '$' << COLOUR_NORMAL;
    if (len + 1 == width) {
-      std::cout << std::endl;
+      std::cout << '\n';
       return; }
    eol_out();
 }
@@ -174,7 +170,7 @@ View::show_keywords()
    const char k[] = "[keywords";
    int n = strlen(k);
    std::cout << k;
-   for (auto i : keywords) {
+   for (auto i : keywords.words()) {
       int d = strlen(i) + 1;
       if (n + d > 80) {
          n = 0;
@@ -197,23 +193,23 @@ View::show_rot13()
    const int col = window_width_ - strlen(row_header);
 
    Str s { buf_->get_line(line) };
-   for (int i = 0; i < min(col, s.len()); i++) {
-      int c = s[i];
+   for (auto i = s.at(0); i.index() < min(col, s.len()); ++i) {
+      int c = *i;
       if (c >= 0x100) {
-         s.output_char(i);
+         i.output();
          continue; }
 
       if ((c >= 'a' && c <= 'm') || (c >= 'A' && c <= 'M')) c += 13; else
       if ((c >= 'n' && c <= 'z') || (c >= 'N' && c <= 'Z')) c -= 13;
       std::cout << (char)c; }
 
-   if (col > s.len()) eol_out(); else std::cout << std::endl;
+   if (col > s.len()) eol_out(); else std::cout << '\n';
 }
 
 void
 View::show()
 {
-   std::vector<const char *> v;
+   std::vector<Span> v;
    const int from = window_offset_, to = window_offset_ + window_height_;
    const int cursor_line = window_offset_ + cursor_row_;
    const int lnum_col_max = max(lnum_col(from), lnum_col(to - 1));
@@ -223,7 +219,9 @@ View::show()
    std::cout << COLOUR_GREY_BG;
    std::cout << "== " << buf_->filename() <<
                 (buf_->new_file() ? " N" : buf_->dirty() ? " *" : "") <<
-                " [" << from << ":" << to << "] ==";
+                " [" << from << ":" << to << "]";
+   status_out();
+   std::cout << " ==";
    eol_out();
    std::cout << COLOUR_NORMAL;
 
@@ -276,10 +274,13 @@ View::cursor_move_word_next(int (*f)(int))
    Str s { buf_->get_line(line) };
    const int len = s.len();
 
-   for (int i = cursor_column_; i < len; i++)
-      if (!f(s[i]) && f(s[i + 1])) {
-         cursor_column_ = i + 1;
-         break; }
+   auto i = s.at(cursor_column_);
+   for (int c = *i; i.index() < len; ) {
+      int c0 = c;
+      c = *++i;
+      if (!f(c0) && f(c)) {
+         cursor_column_ = i.index();
+         break; } }
 }
 
 void
@@ -291,10 +292,13 @@ View::cursor_move_word_prev(int (*f)(int))
    Str s { buf_->get_line(line) };
    const int len = s.len();
 
-   for (int i = min(cursor_column_, len) - 1; i > 0; i--)
-      if (!f(s[i - 1]) && f(s[i])) {
-         cursor_column_ = i;
-         return; }
+   auto i = s.at(min(cursor_column_, len) - 1);
+   for (int c = *i; i.index() > 0; ) {
+      int c1 = c;
+      c = *--i;
+      if (!f(c) && f(c1)) {
+         cursor_column_ = i.index() + 1;
+         return; } }
    if (cursor_column_ > 0 && f(s[0])) // special case
       cursor_column_ = 0;
 }
@@ -305,8 +309,8 @@ View::cursor_move_para_next()
    const int line = max(0, window_offset_ + cursor_row_ + 1);
 
    for (int i = line; i < buf_->num_of_lines(); i++) {
-      if (!*buf_->get_line(i) &&
-           *buf_->get_line(i + 1)) {
+      if (!buf_->get_line(i).size &&
+           buf_->get_line(i + 1).size) {
          cursor_row_ = i + 1 - window_offset_;
          break; }
    }
@@ -319,32 +323,105 @@ View::cursor_move_para_prev()
                         window_offset_ + cursor_row_ - 1);
 
    for (int i = line; i >= 0; i--) {
-      if ((!i || !*buf_->get_line(i - 1)) &&
-           *buf_->get_line(i)) {
+      if ((!i || !buf_->get_line(i - 1).size) &&
+           buf_->get_line(i).size) {
          cursor_row_ = i - window_offset_;
          break; }
    }
 }
 
+// The cursor line first, then the hit index for the nearest line with one.
+// While the index is being built, or the lines after the cursor are still
+// coming in with no hit so far, the search waits for them instead of the
+// editor: it is tried again on each frame.
 void
 View::keyword_search_next()
 {
-   std::vector<const char *> v;
-   const int from = window_offset_ + cursor_row_;
-   const int to   = window_offset_ + window_height_;
-   buf_->show(v, from, to);
+   search_ = 0;
+   const int line = window_offset_ + cursor_row_;
+   if (line >= 0 && line < buf_->num_of_lines()) {
+      Str s { buf_->get_line(line) };
+      auto found = s.search_word(keywords, cursor_column_ + 1);
+      if (found != -1) { cursor_column_ = found; return; } }
+
+   auto &h = buf_->hits();
+   const int n = h.ready() ? h.next(line) : -1;
+   if (n < 0) {
+      if (!h.ready() || buf_->loading()) search_later(+1);
+      return; }
+   Str s { buf_->get_line(n) };
+   cursor_goto(n, s.search_word(keywords, 0));
+}
+
+void
+View::keyword_search_prev()
+{
+   search_ = 0;
+   const int line = window_offset_ + cursor_row_;
+   if (line >= 0 && line < buf_->num_of_lines()) {
+      Str s { buf_->get_line(line) };
+      auto found = s.search_word_prev(keywords, min(cursor_column_, s.len()));
+      if (found != -1) { cursor_column_ = found; return; } }
 
-   for (int i = 0; i < to - from; i++)
-   {
-      if (i == v.size()) return;
-      Str s { v[i] };
-      int d = i ? 0 : cursor_column_ + 1;
-      auto found = s.search_word(keywords, d);
-      if (found == -1) continue;
+   auto &h = buf_->hits();
+   if (!h.ready()) return search_later(-1);
+   const int n = h.prev(line);
+   if (n < 0) return;
+   Str s { buf_->get_line(n) };
+   cursor_goto(n, s.search_word_prev(keywords, s.len()));
+}
 
-      cursor_row_    += i;
-      cursor_column_  = found;
-      return; }
+void
+View::search_later(int d)
+{
+   search_        = d;
+   search_line_   = window_offset_ + cursor_row_;
+   search_column_ = cursor_column_;
+}
+
+// as long as the cursor has not moved since
+void
+View::keyword_search_again()
+{
+   if (!search_) return;
+   const int d = search_;
+   search_ = 0;
+   if (search_line_ != window_offset_ + cursor_row_ ||
+       search_column_ != cursor_column_) return;
+   if (d > 0) keyword_search_next(); else keyword_search_prev();
+}
+
+// scrolls line to the middle when it is off the window
+void
+View::cursor_goto(int line, int col)
+{
+   cursor_row_    = line - window_offset_;
+   cursor_column_ = col;
+   if (cursor_row_ < 0 || cursor_row_ >= window_height_) {
+      window_offset_ = line - window_height_ / 2;
+      cursor_row_    = line - window_offset_; }
+}
+
+// for the mode line: how much of the file is in, the hit count, a search
+// still waiting and, if asked for, the last command's latency
+void
+View::status_out()
+{
+   if (buf_->loading()) std::cout << " [loading " << buf_->load_percent() << "%]";
+   hits_out();
+   if (search_) std::cout << " [searching...]";
+   if (latency.live()) latency.out(std::cout);
+}
+
+// hit count; "..." while the index is being built
+void
+View::hits_out()
+{
+   if (keywords.empty()) return;
+   auto &h = buf_->hits();
+   std::cout << " [";
+   if (h.ready()) std::cout << h.total(); else std::cout << "...";
+   std::cout << " hits]";
 }
 
 void
@@ -357,45 +434,37 @@ View::keyword_toggle()
    const int len = s.len();
    if (cursor_column_ >= len) return;
 
-   int cc = cursor_column_, i0, i1;
-   if (!isalpha(s[cc])) return;
-   for (int i = cc; i >= 0  && isalpha(s[i]); i--) i0 = i;
-   for (int i = cc; i < len && isalpha(s[i]); i++) i1 = i + 1;
-   int b0 = s.index_chars_to_bytes(i0);
-   int b1 = s.index_chars_to_bytes(i1);
-   int size = b1 - b0;
-   char *buf = (char *)malloc(size + 1);
-   memcpy(buf, &buf_->get_line(line)[b0], size);
-   buf[size] = '\0';
-
-   auto i = find_if(keywords.begin(), keywords.end(), [&buf](const char *s) {
-         return strcmp(s, buf) == 0; });
-   if (i == keywords.end())
-      // append keyword
-      keywords.push_back((const char *)buf);
-   else {
-      // delete keyword
-      free((void *)*i);
-      keywords.erase(i); }
+   int cc = cursor_column_;
+   auto i0 = s.at(cc), i1 = i0;
+   if (!isalpha(*i0)) return;
+   while (i0.index() > 0 && isalpha(*--i0)) ;
+   if (!isalpha(*i0)) ++i0;
+   while (isalpha(*++i1)) ;
+   int b0 = i0.pos();
+   int b1 = i1.pos();
+
+   keywords.toggle(&buf_->get_line(line).s[b0], b1 - b0);
+   buf_->hits().rebuild();
 }
 
 int
-count_indent(const char *s)
+count_indent(Span s)
 {
    int i;
-   for (i = 0; s[i] == ' '; i++) ;
+   for (i = 0; i < s.size && s.s[i] == ' '; i++) ;
    return i;
 }
 
-const char *
-copy_indent(int n, const char *s0)
+// n spaces, then s0 from byte n0
+Span
+copy_indent(int n, Span s0, int n0)
 {
-   int len = strlen(s0);
-   char *s = (char *)malloc(n + len + 1);
-   if (!s) return s;
+   int len = s0.size - n0;
+   char *s = line_new(n + len);
+   if (!s) return Span { s, 0 };
    memset(s, ' ', n);
-   strcpy(&s[n], s0);
-   return s;
+   memcpy(&s[n], &s0.s[n0], len);
+   return Span { s, n + len };
 }
 
 int
@@ -404,9 +473,9 @@ parent_indent(Buf *b, int line, int n0)
    int n1;
    for (int line2 = line - 1; ; line2--) {
       if (line2 < 0) return -1;
-      const char *s1 = b->get_line(line2);
+      Span s1 = b->get_line(line2);
       n1 = count_indent(s1);
-      if (!s1[n1]) continue;
+      if (n1 == s1.size) continue;
       if (n0 > n1) break; }
    return n1;
 }
@@ -416,11 +485,11 @@ View::indent()
 {
    int line = window_offset_ + cursor_row_;
    if (line < 1 || line >= buf_->num_of_lines()) return;
-   const char *s0 = buf_->get_line(line);
-   const char *s1 = buf_->get_line(line - 1);
+   Span s0 = buf_->get_line(line);
+   Span s1 = buf_->get_line(line - 1);
    int n0 = count_indent(s0);
    int n1 = count_indent(s1);
-   if (!s1[n1] && line >= 2) {
+   if (n1 == s1.size && line >= 2) {
       s1 = buf_->get_line(line - 2);
       n1 = count_indent(s1); }
    if (n0 == n1) {
@@ -428,9 +497,8 @@ View::indent()
       if (n1 < 0) return;
       n1 = n0 + n0 - n1; }
 
-   const char *s = copy_indent(n1, &s0[n0]);
-   if (!s) return;
-   free((void *)s0);
+   Span s = copy_indent(n1, s0, n0);
+   if (!s.s) return;
    buf_->replace_line(line, s);
 
    cursor_column_ = n1;
@@ -441,14 +509,13 @@ View::exdent()
 {
    int line = window_offset_ + cursor_row_;
    if (line < 1 || line >= buf_->num_of_lines()) return;
-   const char *s0 = buf_->get_line(line);
+   Span s0 = buf_->get_line(line);
    int n0 = count_indent(s0);
    if (!n0) return;
    int n1 = parent_indent(buf_, line, n0);
    if (n1 < 0) return;
-   const char *s = copy_indent(n1, &s0[n0]);
-   if (!s) return;
-   free((void *)s0);
+   Span s = copy_indent(n1, s0, n0);
+   if (!s.s) return;
    buf_->replace_line(line, s);
 
    cursor_column_ = n1;
@@ -459,20 +526,19 @@ View::join()
 {
    int line = window_offset_ + cursor_row_;
    if (line < 0 || line + 1 >= buf_->num_of_lines()) return;
-   const char *s0 = buf_->get_line(line);
-   const char *s1 = buf_->get_line(line + 1);
+   Span s0 = buf_->get_line(line);
+   Span s1 = buf_->get_line(line + 1);
 
-   if (!*s0) return buf_->delete_line(line);
-   if (!*s1) return buf_->delete_line(line + 1);
+   if (!s0.size) return buf_->delete_line(line);
+   if (!s1.size) return buf_->delete_line(line + 1);
 
-   const int len = strlen(s0) + strlen(s1);
-   char *s = (char *)malloc(len + 1);
+   const int len = s0.size + s1.size;
+   char *s = line_new(len);
    if (!s) return;
 
-   strcpy(s, s0);
-   strcat(s, s1);
-   free((void *)s0);
-   buf_->replace_line(line, s);
+   memcpy(s, s0.s, s0.size);
+   memcpy(s + s0.size, s1.s, s1.size);
+   buf_->replace_line(line, Span { s, len });
    buf_->delete_line(line + 1);
 }
 
@@ -481,13 +547,11 @@ View::duplicate_line()
 {
    int line = window_offset_ + cursor_row_;
    if (line < 0 || line >= buf_->num_of_lines()) return;
-   const char *s0 = buf_->get_line(line);
-   const char *s1 = strdup(s0);
+   Span s0 = buf_->get_line(line);
+   const char *s1 = line_dup(s0.s, s0.size);
    if (!s1) return;
    buf_->insert_empty_line(line);
-   const char *s2 = buf_->get_line(line);
-   buf_->replace_line(line, s1);
-   free((void *)s2);
+   buf_->replace_line(line, Span { s1, s0.size });
 }
 
 void
@@ -495,11 +559,7 @@ View::transpose_lines()
 {
    int line = window_offset_ + cursor_row_;
    if (line < 0 || line + 1 >= buf_->num_of_lines()) return;
-   const char *s0 = buf_->get_line(line);
-   const char *s1 = buf_->get_line(line + 1);
-
-   buf_->replace_line(line,     s1);
-   buf_->replace_line(line + 1, s0);
+   buf_->transpose_lines(line);
 }
 
 // +-0-+-1-+-2-+      +-0-+-1-+-2-+
@@ -511,14 +571,13 @@ View::transpose_chars()
 {
    int line = window_offset_ + cursor_row_;
    if (line < 0 || line >= buf_->num_of_lines()) return;
-   const char *s0 = buf_->get_line(line);
-   if (!s0) return;
-   char *s1 = strdup(s0);
-   if (!s1) return;
-   Str s { s1 };
+   Span s0 = buf_->get_line(line);
+   Str s { s0 };
    int cc = cursor_column_;
    if (cc > s.len()) cc = s.len();
    if (cc < 2) return;
+   char *s1 = line_dup(s0.s, s0.size);
+   if (!s1) return;
    int offset0 = s.index_chars_to_bytes(cc - 2);
    int offset1 = s.index_chars_to_bytes(cc - 1);
    int offset2 = s.index_chars_to_bytes(cc);
@@ -527,14 +586,16 @@ View::transpose_chars()
       s1[offset0] = s1[offset1];
       s1[offset1] = t; }
    else { /* TODO non-ascii char */ }
-   free((void *)s0);
-   buf_->replace_line(line, s1);
+   buf_->replace_line(line, Span { s1, s0.size });
 }
 
 void
 View::new_line()
 {
-   buf_->insert_empty_line(window_offset_ + cursor_row_++);
+   const int line = window_offset_ + cursor_row_;
+   const int n = buf_->insert_empty_line(line);
+   if (n == line) cursor_row_++;
+   else cursor_goto(n + 1, cursor_column_);
 }
 
 void
@@ -542,19 +603,16 @@ View::insert_new_line(bool left)
 {
    int line = window_offset_ + cursor_row_;
    if (line < 0 || line >=buf_->num_of_lines()) return;
-   char *s0 = (char *)buf_->get_line(line);
+   Span s0 = buf_->get_line(line);
 
-   if (!*s0) return new_line();
+   if (!s0.size) return new_line();
 
    Str s { s0 };
-   const int len = s.len();
    const int index = s.index_chars_to_bytes(cursor_column_);
-   const char *t, *b; // top, bottom
-   b = strdup(&s0[index]);
-   s0[index] = '\0';
-   t = strdup(s0);
+   Span t, b; // top, bottom
+   b = Span { line_dup(&s0.s[index], s0.size - index), s0.size - index };
+   t = Span { line_dup(s0.s, index), index };
 
-   free((void *)s0);
    if (left) {
       cursor_row_++;
       cursor_column_ = 0; }
@@ -566,28 +624,48 @@ View::insert_new_line(bool left)
 void
 View::char_insert(char c)
 {
-   const int line = window_offset_ + cursor_row_;
+   int line = window_offset_ + cursor_row_;
    if (line < 0 || line > buf_->num_of_lines()) return;
-   if (line == buf_->num_of_lines())
-      buf_->insert_empty_line(line);
+   if (line == buf_->num_of_lines()) {
+      line = buf_->insert_empty_line(line);
+      cursor_goto(line, cursor_column_); }
 
-   const char *s0 = buf_->get_line(line);
+   Span s0 = buf_->get_line(line);
    Str s { s0 };
    const int size = s.size();
-   char *s1 = (char *)malloc(size + 2); // \0, c
+   char *s1 = line_new(size + 1);
    if (!s1) return;
 
    const int len = s.len();
    if (cursor_column_ > len) cursor_column_ = len;
 
    const int index = s.index_chars_to_bytes(cursor_column_);
-   strcpy(s1, s0);
+   memcpy(s1, s0.s, index);
    s1[index] = c;
-   strcpy(s1 + index + 1, s0 + index);
+   memcpy(s1 + index + 1, s0.s + index, size - index);
 
    cursor_column_++;
-   free((void *)s0);
-   buf_->replace_line(line, s1);
+   buf_->replace_line(line, Span { s1, size + 1 });
+}
+
+// however many lines s has, it goes in as one Buf operation
+void
+View::paste(const char *s, int size)
+{
+   int line = window_offset_ + cursor_row_;
+   if (line < 0 || line > buf_->num_of_lines()) return;
+   if (line == buf_->num_of_lines()) {
+      line = buf_->insert_empty_line(line);
+      cursor_goto(line, cursor_column_); }
+
+   Str s0 { buf_->get_line(line) };
+   const int len = s0.len();
+   if (cursor_column_ > len) cursor_column_ = len;
+   const int tail = len - cursor_column_;
+
+   const int n = buf_->insert_text(line, s0.index_chars_to_bytes(cursor_column_),
+                                   s, size);
+   cursor_goto(line + n, buf_->line_length(line + n) - tail);
 }
 
 void
@@ -596,11 +674,9 @@ View::char_delete_forward()
    const int line = window_offset_ + cursor_row_;
    if (line < 0 || line >=buf_->num_of_lines()) return;
 
-   const char *s0 = buf_->get_line(line);
+   Span s0 = buf_->get_line(line);
    Str s { s0 };
    const int size = s.size();
-   char *s1 = (char *)malloc(size);
-   if (!s1) return;
 
    const int len = s.len();
    if (cursor_column_ >= len) {
@@ -609,11 +685,13 @@ View::char_delete_forward()
 
    const int index0 = s.index_chars_to_bytes(cursor_column_);
    const int index1 = s.index_chars_to_bytes(cursor_column_ + 1);
-   strncpy(s1, s0, index0);
-   strcpy(s1 + index0, s0 + index1);
+   const int size1  = size - (index1 - index0);
+   char *s1 = line_new(size1);
+   if (!s1) return;
+   memcpy(s1, s0.s, index0);
+   memcpy(s1 + index0, s0.s + index1, size - index1);
 
-   free((void *)s0);
-   buf_->replace_line(line, s1);
+   buf_->replace_line(line, Span { s1, size1 });
 }
 
 void
@@ -634,20 +712,17 @@ View::char_delete_to_eol()
    const int line = window_offset_ + cursor_row_;
    if (line < 0 || line >=buf_->num_of_lines()) return;
 
-   const char *s0 = buf_->get_line(line);
+   Span s0 = buf_->get_line(line);
    Str s { s0 };
    const int len = s.len();
 
    if (cursor_column_ >= len) { return; /* do not join */ }
 
    const int index = s.index_chars_to_bytes(cursor_column_);
-   char *s1 = (char *)malloc(index + 1);
+   char *s1 = line_dup(s0.s, index);
    if (!s1) return;
-   strncpy(s1, s0, index);
-   s1[index] = '\0';
 
-   free((void *)s0);
-   buf_->replace_line(line, s1);
+   buf_->replace_line(line, Span { s1, index });
 }
 
 void
@@ -656,17 +731,16 @@ View::char_delete_to_bol()
    const int line = window_offset_ + cursor_row_;
    if (line < 0 || line >=buf_->num_of_lines()) return;
 
-   const char *s0 = buf_->get_line(line);
+   Span s0 = buf_->get_line(line);
    Str s { s0 };
    const int len = s.len();
    const int cc = min(cursor_column_, len);
    const int index = s.index_chars_to_bytes(cc);
-   char *s1 = strdup(&s0[index]);
+   char *s1 = line_dup(&s0.s[index], s0.size - index);
    if (!s1) return;
    cursor_column_ = 0;
 
-   free((void *)s0);
-   buf_->replace_line(line, s1);
+   buf_->replace_line(line, Span { s1, s0.size - index });
 }
 
 void
@@ -675,20 +749,17 @@ View::char_rotate_variant()
    const int line = window_offset_ + cursor_row_;
    if (line < 0 || line >=buf_->num_of_lines()) return;
 
-   const char *s0 = buf_->get_line(line);
+   Span s0 = buf_->get_line(line);
    Str s { s0 };
    if (cursor_column_ < 0 || cursor_column_ >= s.len()) return;
 
    const int index0 = s.index_chars_to_bytes(cursor_column_);
    const int index1 = s.index_chars_to_bytes(cursor_column_ + 1);
    const int len = index1 - index0;
-   char *from = (char *)malloc(len + 1);
-   if (!from) return;
-   strncpy(from, &s0[index0], len);
-   from[len] = '\0';
+   const std::string from(&s0.s[index0], len);   // a key, not a line
 
 #include "rottable.h"
-   const char *to = strstr(table_rotate_variant, from);
+   const char *to = strstr(table_rotate_variant, from.c_str());
    if (!to) return;
    Str t { to };
    const int index2 = t.index_chars_to_bytes(1);
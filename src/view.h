@@ -10,6 +10,7 @@ namespace e {
 class View {
 public:
    View(Buf * buf);
+   virtual ~View() { }
    virtual void show();
    virtual void page_down() { window_offset_ += window_height_; }
    virtual void page_up()   { window_offset_ -= window_height_; }
@@ -33,9 +34,11 @@ public:
    virtual void cursor_move_para_prev();
 
    virtual void window_centre_cursor();
+   virtual void resize();              // to the terminal
 
    virtual void keyword_search_next();
-   virtual void keyword_search_prev() { }
+   virtual void keyword_search_prev();
+   void keyword_search_again();        // one the hit index was not ready for
    virtual void keyword_toggle();
    virtual void show_keywords();
    virtual void show_rot13();
@@ -48,12 +51,24 @@ public:
    virtual void new_line();
    virtual void insert_new_line(bool left=true);
    virtual void char_insert(char c);
+   virtual void paste(const char *s, int size);
    virtual void char_delete_forward();
    virtual void char_delete_backward();
    virtual void char_delete_to_eol();
    virtual void char_delete_to_bol();
    virtual void char_rotate_variant();
 
+   // table view only: the char under the cursor splits rows, fields may
+   // or may not be quoted; rows in order of the cursor's field, or just
+   // those whose field is ('='), is not ('!') the cursor's or has a
+   // keyword ('~')
+   virtual void separator() { }
+   virtual void quotes() { }
+   virtual void sort_rows(bool) { }
+   virtual void filter_rows(char) { }
+   virtual void all_rows() { }
+   virtual bool ready() { return true; }   // nothing more from a worker
+
 protected:
    Buf *buf_;
    int  window_offset_;
@@ -61,8 +76,15 @@ protected:
    int  window_width_;
    int  cursor_row_;
    int  cursor_column_; // chars
+   // a search waiting for the hit index: +1 next, -1 previous, from where
+   // the cursor was
+   int  search_, search_line_, search_column_;
 
-   virtual void keyword_hilit_colour(const char *s, int col, int width);
+   virtual void keyword_hilit_colour(Span s, int col, int width);
+   void cursor_goto(int line, int col);
+   void status_out();
+   void hits_out();
+   void search_later(int d);
 };
 
 } // namespace
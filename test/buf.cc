@@ -0,0 +1,73 @@
+// Buf while a big file is still loading: a line typed past the lines in
+// so far ends up at the end of the file, not among those loaded later.
+
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "alloc.h"
+#include "buf.h"
+
+using namespace e;
+
+namespace {
+
+const int lines = 2000000;
+int failed = 0;
+
+void
+check(bool ok, const char *what)
+{
+   printf("buf: %s: %s\n", what, ok ? "ok" : "FAILED");
+   if (!ok) failed++;
+}
+
+std::string
+make_file()
+{
+   const char *tmp = getenv("TMPDIR");
+   std::string name = std::string(tmp ? tmp : "/tmp") + "/test_buf.XXXXXX";
+   const int fd = mkstemp(&name[0]);
+   FILE *f = fd == -1 ? nullptr : fdopen(fd, "w");
+   if (!f) {
+      perror(name.c_str());
+      exit(1); }
+   for (int i = 0; i < lines; i++)
+      fprintf(f, "line %d\n", i);
+   if (fclose(f) == EOF) {
+      perror(name.c_str());
+      exit(1); }
+   return name;
+}
+
+void
+test_typed_past_tail()
+{
+   const std::string name = make_file();
+   Buf b(name.c_str());
+   b.wait_lines(1000);
+   check(b.loading() && b.num_of_lines() < lines, "still loading");
+
+   const int n = b.insert_empty_line(b.num_of_lines());
+   const char typed[] = "typed";
+   char *s = line_new(sizeof typed - 1);
+   memcpy(s, typed, sizeof typed - 1);
+   b.replace_line(n, Span { s, int(sizeof typed - 1) });
+   b.wait_loaded();
+
+   const Span l = b.get_line(b.num_of_lines() - 1);
+   check(n == lines && b.num_of_lines() == lines + 1 &&
+         l.size == 5 && !memcmp(l.s, typed, 5), "typed past the loaded tail");
+   unlink(name.c_str());
+}
+
+}
+
+int
+main()
+{
+   test_typed_past_tail();
+   return failed ? 1 : 0;
+}
@@ -0,0 +1,41 @@
+// Keys read into Input ahead of a handler that takes only so many at a
+// time are all handled, with nothing more coming in on the fd.
+
+#include <unistd.h>
+#include <cstdio>
+#include <string>
+
+#include "input.h"
+#include "loop.h"
+
+using namespace e;
+
+int
+main()
+{
+   const int keys = 3000, batch = 100;   // more than one "frame" each
+   int fd[2];
+   if (pipe(fd) == -1) { perror("pipe"); return 1; }
+   const std::string s(keys, 'a');
+   if (write(fd[1], s.data(), s.size()) != (ssize_t)s.size()) {
+      perror("write");
+      return 1; }
+
+   Input input(fd[0]);
+   Loop loop;
+   int handled = 0;
+   bool timed_out = false;
+   loop.watch(fd[0], [&]() {
+         for (int i = 0; i < batch && input.pending(); i++) {
+            input.get();
+            handled++; }
+         if (handled == keys) loop.quit(); },
+      [&]() { return input.pending(); });
+   loop.after(2000, [&]() { timed_out = true; loop.quit(); });
+   loop.run();
+
+   // the write end stays open: no EOF to wake the loop either
+   printf("loop: %d of %d keys handled%s\n", handled, keys,
+          timed_out ? ", timed out" : "");
+   return handled == keys ? 0 : 1;
+}
@@ -0,0 +1,99 @@
+// Column on small DSV files: a filter that keeps no rows, then a sort of
+// those, still has none; words from_chars() reads as infinite or NaN are
+// text to the sums; lines deleted before the column widths are first
+// counted are not in them.
+
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "buf.h"
+#include "table.h"
+
+using namespace e;
+
+namespace {
+
+int failed = 0;
+
+void
+check(bool ok, const char *what)
+{
+   printf("table: %s: %s\n", what, ok ? "ok" : "FAILED");
+   if (!ok) failed++;
+}
+
+std::string
+make_file(const char *text)
+{
+   const char *tmp = getenv("TMPDIR");
+   std::string name = std::string(tmp ? tmp : "/tmp") + "/test_table.XXXXXX";
+   const int fd = mkstemp(&name[0]);
+   if (fd == -1 || write(fd, text, strlen(text)) == -1 || close(fd) == -1) {
+      perror(name.c_str());
+      exit(1); }
+   return name;
+}
+
+void
+test_empty_rows()
+{
+   const std::string name = make_file("a:1\nb:2\nc:3\n");
+   Buf b(name.c_str());
+   b.wait_loaded();
+
+   Column all(b);
+   all.cut(0, b.dsv());
+   std::vector<int> none = all.filter([](Column::Cell) { return false; });
+   check(none.empty(), "filter keeping nothing");
+
+   Column c(b, none);
+   c.cut(1, b.dsv());
+   check(c.size() == 0 && c.sorted(false).empty(), "sort of no rows");
+   unlink(name.c_str());
+}
+
+void
+test_not_numbers()
+{
+   const std::string name =
+      make_file("a:1\nb:inf\nc:2\nd:nan\ne:Infinity\nf:-INF\ng:+NaN\n");
+   Buf b(name.c_str());
+   b.wait_loaded();
+
+   Column c(b);
+   c.cut(1, b.dsv());
+   const Column::Stats st = c.stats();
+   check(st.count == 2 && st.sum == 3 && st.min == 1 && st.max == 2,
+         "inf and nan are no numbers");
+   check(!c.numeric(), "a column of mostly them is text");
+   unlink(name.c_str());
+}
+
+void
+test_widths()
+{
+   const std::string name = make_file("a:1\nbbbbbbbbbb:2\nc:3\n");
+   Buf b(name.c_str());
+   b.wait_loaded();
+
+   b.delete_line(1);
+   Columns &c = b.columns();
+   c.build();
+   c.wait();
+   check(c.width(0) == 1 && c.width(1) == 1, "a line deleted before build");
+   unlink(name.c_str());
+}
+
+}
+
+int
+main()
+{
+   test_empty_rows();
+   test_not_numbers();
+   test_widths();
+   return failed ? 1 : 0;
+}